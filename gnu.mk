@@ -1 +1 @@
-LDFLAGS+=-ldl
+LDFLAGS+=-ldl -lpthread
@@ -2,15 +2,25 @@
 #include "backend.h"
 #include "game.h"
 #include <math.h>
+#include <algorithm>
 #include <vector>
 #include <memory>
 #include <map>
+#include <atomic>
+#include <chrono>
+#include <thread>
 #include "SDL.h"
 
 namespace
 {
-int gameTicks = 0;
-auto const GAME_PERIOD_IN_TICKS = 20;
+using Clock = std::chrono::steady_clock;
+auto const GAME_PERIOD = std::chrono::milliseconds(20);
+
+// max time spent simulating in each period, the rest is left to rendering
+auto const SIMULATION_BUDGET = GAME_PERIOD * 3 / 4;
+
+auto const MAX_SPEED = 1000.0f;
+
 ///////////////////////////////////////////////////////////////////////////////
 // ImVec2 primitives
 
@@ -51,13 +61,248 @@ intptr_t getTexture(const char* path)
 
 const float SCALE = 64.0;
 
+// the flow animation was tuned for 60Hz
+const float FLOW_FRAME_MS = 1000.0 / 60.0;
+
 intptr_t textureSelection;
 intptr_t textureBackground;
 intptr_t textureHover;
 intptr_t textureFlow;
 
-Actor* g_selection;
+int g_selection = -1; // index in GameGetActors()
 bool g_debug;
+ImVec2 g_plantSize; // in pixels, see measurePlant()
+
+///////////////////////////////////////////////////////////////////////////////
+// Simulation thread
+
+std::thread g_simThread;
+std::atomic<bool> g_simRunning;
+std::atomic<float> g_speed { 1 }; // requested ticks per period
+std::atomic<float> g_realTimeFactor { 0 }; // achieved
+
+void simMain()
+{
+  auto next = Clock::now();
+  auto measureStart = next;
+  int measuredTicks = 0;
+  float pending = 0;
+
+  while(g_simRunning)
+  {
+    auto const start = Clock::now();
+
+    pending += g_speed;
+
+    while(pending >= 1 && !IsGameFinished())
+    {
+      GameTick();
+      ++measuredTicks;
+      pending -= 1;
+
+      // too slow: drop the remaining ticks instead of catching up later
+      if(Clock::now() - start > SIMULATION_BUDGET)
+      {
+        pending = 0;
+        break;
+      }
+    }
+
+    if(IsGameFinished())
+      pending = 0;
+
+    auto const now = Clock::now();
+
+    if(now - measureStart >= std::chrono::seconds(1))
+    {
+      g_realTimeFactor = measuredTicks * GAME_PERIOD / std::chrono::duration<float>(now - measureStart);
+      measureStart = now;
+      measuredTicks = 0;
+    }
+
+    next += GAME_PERIOD;
+
+    // after a hitch, restart from now instead of bursting
+    if(next < now)
+      next = now;
+
+    std::this_thread::sleep_until(next);
+  }
+}
+
+void startSimulation()
+{
+  g_simRunning = true;
+  g_simThread = std::thread(simMain);
+}
+
+void stopSimulation()
+{
+  g_simRunning = false;
+
+  if(g_simThread.joinable())
+    g_simThread.join();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Operator commands. When the simulation is too busy to take them, they wait
+// here, in order, and are sent again on the next frames.
+
+std::vector<Command> g_unsent;
+
+bool send(const Command& cmd)
+{
+  if(cmd.kind == Command::SetFloat)
+    return GameSetProperty(cmd.actor, cmd.property, cmd.floatValue);
+
+  return GameSetProperty(cmd.actor, cmd.property, cmd.boolValue);
+}
+
+void sendUnsent()
+{
+  int sent = 0;
+
+  while(sent < (int)g_unsent.size() && send(g_unsent[sent]))
+    ++sent;
+
+  g_unsent.erase(g_unsent.begin(), g_unsent.begin() + sent);
+}
+
+void queue(const Command& cmd)
+{
+  // nothing overtakes a command already waiting
+  if(g_unsent.empty() && send(cmd))
+    return;
+
+  // a slider still being dragged: only its last value matters
+  if(!g_unsent.empty() && g_unsent.back().actor == cmd.actor && g_unsent.back().property == cmd.property)
+    g_unsent.back() = cmd;
+  else
+    g_unsent.push_back(cmd);
+}
+
+void setProperty(int actor, int property, float value)
+{
+  Command cmd;
+  cmd.kind = Command::SetFloat;
+  cmd.actor = actor;
+  cmd.property = property;
+  cmd.floatValue = value;
+  queue(cmd);
+}
+
+void setProperty(int actor, int property, bool value)
+{
+  Command cmd;
+  cmd.kind = Command::SetBool;
+  cmd.actor = actor;
+  cmd.property = property;
+  cmd.boolValue = value;
+  queue(cmd);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Interpolation between the last two published states.
+// We render one tick late, but motion stays smooth whatever the tick rate.
+
+auto const TAU = 6.28318530717958647693;
+
+GameState g_previous;
+GameState g_latest;
+float g_alpha = 1; // from previous to latest
+Clock::time_point g_previousTime;
+Clock::time_point g_latestTime;
+
+float lerp(float a, float b, float alpha)
+{
+  return a + (b - a) * alpha;
+}
+
+// takes the shortest way around
+float lerpAngle(float a, float b, float alpha)
+{
+  auto delta = fmod(b - a, TAU);
+
+  if(delta > TAU / 2)
+    delta -= TAU;
+
+  if(delta < -TAU / 2)
+    delta += TAU;
+
+  return a + delta * alpha;
+}
+
+// Keeps the last two published states. Returns the latest one:
+// its actors get blended one by one, only those being drawn.
+const GameState& interpolate(const GameState& published)
+{
+  auto const now = Clock::now();
+
+  // first state of a new game: ticks restart from 0
+  if(g_latest.tick < 0 || published.tick < g_latest.tick)
+  {
+    g_latest = published;
+    g_latestTime = now;
+    g_previous = published;
+    g_previousTime = now;
+  }
+  else if(published.tick != g_latest.tick)
+  {
+    // the copy reuses the capacity of the state dropped
+    std::swap(g_previous, g_latest);
+    g_previousTime = g_latestTime;
+    g_latest = published;
+    g_latestTime = now;
+  }
+
+  g_alpha = 1;
+
+  if(g_latestTime > g_previousTime)
+    g_alpha = clamp(std::chrono::duration<float>(now - g_latestTime) / (g_latestTime - g_previousTime), 0, 1);
+
+  return g_latest;
+}
+
+// actor 'i' of the latest state, as of now
+ActorState blend(int i)
+{
+  auto actor = g_latest.actors[i];
+
+  if(i >= (int)g_previous.actors.size())
+    return actor;
+
+  auto& prev = g_previous.actors[i];
+  auto const alpha = g_alpha;
+
+  actor.mass = lerp(prev.mass, actor.mass, alpha);
+  actor.temperature = lerp(prev.temperature, actor.temperature, alpha);
+  actor.pressure = lerp(prev.pressure, actor.pressure, alpha);
+  actor.flux0 = lerp(prev.flux0, actor.flux0, alpha);
+
+  if(prev.sprites.size() == actor.sprites.size())
+  {
+    for(int k = 0; k < actor.sprites.size(); ++k)
+      actor.sprites[k].angle = lerpAngle(prev.sprites[k].angle, actor.sprites[k].angle, alpha);
+  }
+
+  // sensor readings. Settings are kept as is, they are being edited.
+  for(int k = 0; k < actor.propertyCount; ++k)
+  {
+    auto& prop = actor.properties[k];
+
+    if(prop.info->type == Type::Float && prop.info->readOnly)
+      prop.value = lerp(prev.properties[k].value, prop.value, alpha);
+  }
+
+  return actor;
+}
+
+void resetInterpolation()
+{
+  g_previous = {};
+  g_latest = {};
+  g_latest.tick = -1;
+}
 
 ImVec2 toImVec2(Vec2f v) { return ImVec2(v.x, v.y); }
 
@@ -92,33 +337,60 @@ void ImageRotated(ImTextureID tex_id, ImVec2 size, float angle, ImVec2 uv0 = ImV
 
 const int H = 512;
 
-void windowReactorControl(ImVec2 size)
+void windowReactorControl(ImVec2 size, const GameState& state)
 {
   ImGui::SetNextWindowPos(ImVec2(0, 0));
   ImGui::SetNextWindowSize(ImVec2(H, size.y));
   ImGui::Begin("Reactor control", nullptr, ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoCollapse);
 
-  if(g_selection)
   {
-    ImGui::Text("Name: %s", g_selection->id.c_str());
-    ImGui::Text("Type: %s", g_selection->name());
+    float speed = g_speed;
+
+    if(ImGui::SliderFloat("Speed", &speed, 1, MAX_SPEED, "x%.0f", 4.0f))
+      g_speed = clamp(speed, 1, MAX_SPEED);
+
+    ImGui::Text("Achieved: x%.1f", g_realTimeFactor.load());
     ImGui::Text("");
+  }
 
-    for(auto& prop : g_selection->introspect())
+  if(g_selection >= 0 && g_selection < (int)state.actors.size())
+  {
+    auto const selection = blend(g_selection);
+
+    ImGui::Text("Name: %s", GameGetIdName(selection.actor->id));
+    ImGui::Text("Type: %s", selection.actor->name());
+    ImGui::Text("");
+
+    for(int k = 0; k < selection.propertyCount; ++k)
     {
-      switch(prop.type)
+      auto& prop = selection.properties[k];
+
+      switch(prop.info->type)
       {
       case Type::Float:
 
-        if(prop.readOnly)
-          ImGui::Text("%s: %.2f", prop.name, *(float*)prop.pointer);
+        if(prop.info->readOnly)
+        {
+          ImGui::Text("%s: %.2f %s", prop.info->name, prop.value, prop.info->unit);
+        }
         else
-          ImGui::SliderFloat(prop.name, (float*)prop.pointer, 0, 1);
+        {
+          float value = prop.value;
+
+          if(ImGui::SliderFloat(prop.info->name, &value, prop.info->min, prop.info->max))
+            setProperty(g_selection, k, value);
+        }
 
         break;
       case Type::Bool:
-        ImGui::Checkbox(prop.name, (bool*)prop.pointer);
-        break;
+        {
+          bool value = prop.value != 0;
+
+          if(ImGui::Checkbox(prop.info->name, &value))
+            setProperty(g_selection, k, value);
+
+          break;
+        }
       }
     }
   }
@@ -130,8 +402,22 @@ void windowReactorControl(ImVec2 size)
   ImGui::End();
 }
 
-void windowReactorDiagram(ImVec2 size, const char* msg)
+// actors don't move: only needed once per game
+void measurePlant()
 {
+  g_plantSize = ImVec2(16 * SCALE, 16 * SCALE); // the background
+
+  for(auto actor : GameGetActors())
+  {
+    auto const corner = toImVec2(actor->pos + actor->size()) * SCALE;
+    g_plantSize.x = std::max(g_plantSize.x, corner.x);
+    g_plantSize.y = std::max(g_plantSize.y, corner.y);
+  }
+}
+
+void windowReactorDiagram(ImVec2 size, const GameState& state, int deltaTicks)
+{
+  auto msg = state.finishMessage;
   auto absMousePos = ImGui::GetMousePos();
   const auto origin = ImVec2(H, 0);
   ImGui::SetNextWindowPos(origin);
@@ -145,18 +431,42 @@ void windowReactorDiagram(ImVec2 size, const char* msg)
   ImGui::SetCursorPos({});
   ImGui::Image((void*)textureBackground, ImVec2(16 * SCALE, 16 * SCALE));
 
+  // the whole plant can be scrolled to, even though most of it isn't drawn
+  ImGui::SetCursorPos({});
+  ImGui::Dummy(g_plantSize);
+
   if(g_debug)
     ImGui::Text("Temperature display");
 
-  for(auto& entity : GameGetActors())
+  // only draw what is in the window
+  const auto viewSize = ImGui::GetWindowSize();
+
+  // the simulation only publishes the readings of what we can see, with
+  // a margin for what gets scrolled into view before the next tick
+  const auto margin = Vec2f(2, 2);
+  const auto viewMin = Vec2f(scrollPos.x, scrollPos.y) * (1 / SCALE);
+  const auto viewMax = Vec2f(scrollPos.x + viewSize.x, scrollPos.y + viewSize.y) * (1 / SCALE);
+  GameSetVisibleArea(viewMin - margin, viewMax + margin, g_selection);
+  auto isVisible = [&] (const ActorState& actor)
+    {
+      auto pos = toImVec2(actor.actor->pos) * SCALE;
+      auto size = toImVec2(actor.actor->size()) * SCALE;
+      return pos.x + size.x >= scrollPos.x && pos.x < scrollPos.x + viewSize.x
+             && pos.y + size.y >= scrollPos.y && pos.y < scrollPos.y + viewSize.y;
+    };
+
+  for(auto& latest : filter(state.actors, isVisible))
   {
+    const int i = &latest - state.actors.data();
+    auto const entityState = blend(i);
+    auto entity = entityState.actor;
     ImVec2 entityPos = toImVec2(entity->pos) * SCALE;
     ImVec2 entitySize = toImVec2(entity->size()) * SCALE;
 
     ImGui::SetCursorPos(entityPos);
     ImGui::Image((void*)getTexture("data/pipe.png"), entitySize);
 
-    for(auto& sprite : entity->sprite())
+    for(auto& sprite : entityState.sprites)
     {
       ImGui::SetCursorPos(entityPos + entitySize * 0.5);
       ImageRotated((void*)getTexture(sprite.texture), entitySize, sprite.angle + entity->angle);
@@ -166,7 +476,7 @@ void windowReactorDiagram(ImVec2 size, const char* msg)
     {
       bool mouseOver = isPointInRect(mousePos, entityPos, entitySize);
 
-      if(entity == g_selection)
+      if(i == g_selection)
       {
         ImGui::SetCursorPos(entityPos);
         ImGui::Image((void*)textureSelection, entitySize);
@@ -177,7 +487,7 @@ void windowReactorDiagram(ImVec2 size, const char* msg)
         ImGui::Image((void*)textureHover, entitySize);
 
         if(ImGui::IsMouseClicked(0))
-          g_selection = entity;
+          g_selection = i;
       }
 
       // show tooltip
@@ -185,17 +495,19 @@ void windowReactorDiagram(ImVec2 size, const char* msg)
       {
         ImGui::BeginTooltip();
         ImGui::Text("%s", entity->name());
-        ImGui::Text("%s", entity->id.c_str());
+        ImGui::Text("%s", GameGetIdName(entity->id));
 
-        for(auto& prop : entity->introspect())
+        for(int k = 0; k < entityState.propertyCount; ++k)
         {
-          switch(prop.type)
+          auto& prop = entityState.properties[k];
+
+          switch(prop.info->type)
           {
           case Type::Float:
-            ImGui::Text("%s: %.2f", prop.name, *(float*)prop.pointer);
+            ImGui::Text("%s: %.2f %s", prop.info->name, prop.value, prop.info->unit);
             break;
           case Type::Bool:
-            ImGui::Text("%s: %s", prop.name, *(bool*)prop.pointer ? "on" : "off");
+            ImGui::Text("%s: %s", prop.info->name, prop.value ? "on" : "off");
             break;
           }
         }
@@ -208,10 +520,11 @@ void windowReactorDiagram(ImVec2 size, const char* msg)
     {
       // flow drawing
       {
-        static std::map<Actor*, float> u;
-        auto& phase = u[entity];
+        static std::map<int, float> u;
+        auto& phase = u[i];
 
-        phase += entity->flux0() * 0.001;
+        // scrolls at the same speed whatever the frame rate
+        phase += entityState.flux0 * 0.001 * deltaTicks / FLOW_FRAME_MS;
 
         if(phase > 1.0)
           phase -= 1.0;
@@ -222,12 +535,12 @@ void windowReactorDiagram(ImVec2 size, const char* msg)
         ImageRotated((void*)textureFlow, entitySize, entity->angle, uv0, uv1);
       }
 
-      uint8_t red = (int)clamp(entity->temperature(), 0, 255);
+      uint8_t red = (int)clamp(entityState.temperature, 0, 255);
       ImGui::GetWindowDrawList()->AddRectFilled(origin - scrollPos + entityPos, origin - scrollPos + entityPos + entitySize, 0x80000000 | red);
       ImGui::SetCursorPos(entityPos);
-      ImGui::Text("P=%.2f", entity->pressure());
+      ImGui::Text("P=%.2f", entityState.pressure);
       ImGui::SetCursorPos(entityPos + ImVec2(0, -16));
-      ImGui::Text("m=%.2f", entity->mass() * 0.001);
+      ImGui::Text("m=%.2f", entityState.mass * 0.001);
     }
   }
 
@@ -253,36 +566,40 @@ void AppInit()
   textureFlow = getTexture("data/flowalpha.png");
 
   GameInit();
+  measurePlant();
+  resetInterpolation();
+  startSimulation();
 }
 
-void AppFrame(ImVec2 size, int deltaTicks)
+void AppShutdown()
 {
-  auto msg = IsGameFinished();
-
-  if(!msg)
-  {
-    gameTicks += deltaTicks;
-
-    while(gameTicks > GAME_PERIOD_IN_TICKS)
-    {
-      GameTick();
-      gameTicks -= GAME_PERIOD_IN_TICKS;
-    }
-  }
-
-  if(msg)
-    g_debug = false;
+  stopSimulation();
+}
 
+void AppFrame(ImVec2 size, int deltaTicks)
+{
   if(ImGui::IsKeyPressed(SDL_SCANCODE_R))
   {
-    g_selection = nullptr;
+    stopSimulation();
+    g_selection = -1;
+    g_unsent.clear();
+    resetInterpolation();
     GameInit();
+    measurePlant();
+    startSimulation();
   }
 
+  sendUnsent();
+
+  // the simulation keeps running while we draw this one
+  auto& state = interpolate(GameGetState());
+
+  if(state.finishMessage)
+    g_debug = false;
+
   if(ImGui::IsKeyPressed(SDL_SCANCODE_SPACE))
     g_debug = !g_debug;
 
-  windowReactorControl(size);
-  windowReactorDiagram(size, msg);
+  windowReactorControl(size, state);
+  windowReactorDiagram(size, state, deltaTicks);
 }
-
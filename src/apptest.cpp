@@ -94,6 +94,10 @@ void AppInit()
   }
 }
 
+void AppShutdown()
+{
+}
+
 void AppFrame(ImVec2 size, int deltaTicks)
 {
   simulate(g_circuit);
@@ -0,0 +1,230 @@
+// Headless benchmarks, for the solver modes meant for large circuits.
+// usage: bench.exe [name filter]
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include "game.h"
+#include "simuflow.h"
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+double secondsSince(Clock::time_point start)
+{
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Ring of 'count' sections, with pumps, heaters and coolers spread over it,
+// run for a while so the flows are established.
+void buildRing(Circuit& circuit, int count)
+{
+  circuit.sections.resize(count);
+
+  for(int i = 0; i < count; ++i)
+  {
+    auto& s = circuit.sections[i];
+    s.mass = 1000;
+    s.T = 25 + (i % 7) * 10;
+
+    if(i % 100 == 0)
+      s.selfFlux = 100;
+
+    if(i % 100 == 25)
+      s.heating = 2;
+
+    if(i % 100 == 75)
+      s.cooling = 0.1;
+  }
+
+  for(int i = 0; i < count; ++i)
+    connectSections(circuit, circuit.sections[i], circuit.sections[(i + 1) % count]);
+
+  for(int tick = 1; tick <= 20; ++tick)
+    simulate(circuit, tick);
+}
+
+// largest differences between two runs
+struct Error
+{
+  float temperature = 0; // in C
+  float mass = 0; // relative
+};
+
+Error compare(const Circuit& a, const Circuit& b)
+{
+  Error r;
+
+  for(int i = 0; i < (int)a.sections.size(); ++i)
+  {
+    auto& sa = a.sections[i];
+    auto& sb = b.sections[i];
+    r.temperature = std::max(r.temperature, fabsf(sa.T - sb.T));
+    r.mass = std::max(r.mass, fabsf(sa.mass - sb.mass) / std::max(1.0f, sa.mass));
+  }
+
+  return r;
+}
+
+// simulateBlocked() against the same steps done by simulate()
+void benchBlocked()
+{
+  auto const N = 4 << 20; // 128MB of sections: more than the LLC
+  auto const STEPS = 16;
+  auto const PASSES = 2;
+
+  Circuit plain;
+  buildRing(plain, N);
+
+  Circuit blocked;
+  buildRing(blocked, N);
+
+  // first pass: builds the adjacency of the circuit
+  for(int tick = 1; tick <= STEPS; ++tick)
+    simulate(plain, tick);
+
+  simulateBlocked(blocked, STEPS);
+
+  auto start = Clock::now();
+
+  for(int tick = STEPS + 1; tick <= STEPS * (PASSES + 1); ++tick)
+    simulate(plain, tick);
+
+  auto const plainTime = secondsSince(start) / (STEPS * PASSES);
+
+  start = Clock::now();
+
+  for(int pass = 0; pass < PASSES; ++pass)
+    simulateBlocked(blocked, STEPS);
+
+  auto const blockedTime = secondsSince(start) / (STEPS * PASSES);
+
+  auto const error = compare(plain, blocked);
+  printf("blocked: %d sections, %d steps per pass\n", N, STEPS);
+  printf("  plain:   %.2f ms/step\n", plainTime * 1000);
+  printf("  blocked: %.2f ms/step\n", blockedTime * 1000);
+  printf("  max error after %d steps: %.3g C, %.3g%% of the mass\n", STEPS * (PASSES + 1), error.temperature, error.mass * 100);
+}
+
+double totalMass(const Circuit& circuit)
+{
+  double r = 0;
+
+  for(auto& s : circuit.sections)
+    r += s.mass;
+
+  return r;
+}
+
+// simulateBlocked() on packed storage, against the same on floats
+void benchPacked()
+{
+  auto const N = 4 << 20;
+  auto const STEPS = 16;
+  auto const PASSES = 4;
+
+  Circuit full;
+  buildRing(full, N);
+
+  Circuit reference;
+  buildRing(reference, N);
+
+  auto packed = pack(full);
+  auto const initialMass = totalMass(full);
+
+  auto start = Clock::now();
+
+  for(int pass = 0; pass < PASSES; ++pass)
+    simulateBlocked(reference, STEPS);
+
+  auto const fullTime = secondsSince(start) / (STEPS * PASSES);
+
+  start = Clock::now();
+
+  for(int pass = 0; pass < PASSES; ++pass)
+    simulateBlocked(packed, STEPS);
+
+  auto const packedTime = secondsSince(start) / (STEPS * PASSES);
+
+  unpack(packed, full);
+
+  auto const error = compare(reference, full);
+  auto const fullSize = sizeof(Section) + sizeof(Connection);
+  auto const packedSize = sizeof(PackedSection) + sizeof(PackedConnection);
+  printf("packed: %d sections, %d steps per pass, %d section types\n", N, STEPS, (int)packed.types.size());
+  printf("  float:  %.2f ms/step, %d bytes per section\n", fullTime * 1000, (int)fullSize);
+  printf("  packed: %.2f ms/step, %d bytes per section\n", packedTime * 1000, (int)packedSize);
+  printf("  scales: %.3g (mass), %.3g C\n", packed.massScale, packed.temperatureScale);
+  printf("  max error after %d steps: %.3g C, %.3g%% of the mass\n", STEPS * PASSES, error.temperature, error.mass * 100);
+  printf("  total mass drift: %.3g packed, %.3g float, out of %.3g\n", totalMass(full) - initialMass, totalMass(reference) - initialMass, initialMass);
+}
+
+// procedural plants of growing sizes: generation, then ticks
+void benchPlant()
+{
+  auto const TICKS = 50;
+
+  for(int units : { 1, 100, 2500 })
+  {
+    auto start = Clock::now();
+    GameInitPlant(units, 1);
+    auto const initTime = secondsSince(start);
+
+    start = Clock::now();
+
+    for(int tick = 0; tick < TICKS; ++tick)
+      GameTick();
+
+    auto const tickTime = secondsSince(start) / TICKS;
+
+    // as seen by the UI: one unit on screen
+    GameGetState();
+    GameSetVisibleArea(Vec2f(0, 0), Vec2f(16, 16), -1);
+
+    for(int tick = 0; tick < 3; ++tick)
+      GameTick(); // every buffer got the static data
+
+    start = Clock::now();
+
+    for(int tick = 0; tick < TICKS; ++tick)
+      GameTick();
+
+    auto const visibleTickTime = secondsSince(start) / TICKS;
+
+    printf("plant: %d units, %d actors\n", units, GameGetActors().size());
+    printf("  generation: %.2f ms\n", initTime * 1000);
+    printf("  tick, publishing everything: %.3f ms\n", tickTime * 1000);
+    printf("  tick, publishing one unit: %.3f ms\n", visibleTickTime * 1000);
+  }
+
+  GameInit();
+}
+
+struct Benchmark
+{
+  const char* name;
+  void (* func)();
+};
+
+const Benchmark benchmarks[] =
+{
+  { "blocked", &benchBlocked },
+  { "packed", &benchPacked },
+  { "plant", &benchPlant },
+};
+}
+
+int main(int argc, char* argv[])
+{
+  auto const filter = argc > 1 ? argv[1] : "";
+
+  for(auto& benchmark : benchmarks)
+  {
+    if(strstr(benchmark.name, filter))
+      benchmark.func();
+  }
+
+  return 0;
+}
@@ -1,13 +1,36 @@
-#include <memory>
+#include <assert.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <math.h>
+#include <mutex>
+#include <stdio.h> // snprintf
+#include <string.h>
+#include <tuple>
+#include <type_traits>
 #include "game.h"
+#include "pool.h"
+#include "random.h"
+#include "ringbuffer.h"
+#include "scheduler.h"
+#include "sensors.h"
 #include "simuflow.h"
+#include "stringtable.h"
+#include "triplebuffer.h"
 
 namespace
 {
+// Entities are stored by concrete type, and ticked by type: each type
+// hides 'tick' with its own non-virtual one, if it has anything to do.
 struct Entity : Actor
 {
+  Circuit* circuit = nullptr;
   Section* section = nullptr;
-  virtual void tick() {};
+  void tick() {}
+
+  // Entities tick in parallel, stage after stage.
+  // Entities reading other entities go to a later stage.
+  static auto const STAGE = 0;
 
   float mass() override
   {
@@ -21,7 +44,7 @@ struct Entity : Actor
 
   float pressure() override
   {
-    return section ? section->P : 0;
+    return section ? section->pressure() : 0;
   }
 
   float flux0() override
@@ -30,33 +53,86 @@ struct Entity : Actor
   }
 };
 
-std::vector<std::unique_ptr<Entity>> g_entities;
-const char* g_finishMessage = nullptr;
+std::vector<Actor*> g_entities; // in spawn order, points into g_pools
+StringTable g_ids;
+std::mutex g_idQueryMutex; // prefix queries sort the table on first use
+std::vector<int> g_actorOfId; // by id handle
+std::atomic<const char*> g_finishMessage { nullptr };
 auto const TAU = 6.28318530717958647693;
 auto const PI = TAU * 0.5;
 
-float blend(float alpha, float a, float b)
+// fast loop: reactor core side
+Circuit g_primary;
+
+// slow loop: cooling tower side
+Circuit g_secondary;
+
+int g_tick;
+
+// instrument readings, updated after the solver, before the entities
+SensorBank g_sensors;
+unsigned g_seed; // of the plant, for all random behaviour
+
+TaskGraph g_tickGraph;
+
+TripleBuffer<GameState> g_published;
+
+// UI thread -> simulation thread
+RingBuffer<Command, 256> g_commands;
+
+struct VisibleArea
 {
-  return (1 - alpha) * a + alpha * b;
+  int game = -1; // ignored if not the current one
+  Vec2f min, max;
+  int selection = -1;
+};
+
+TripleBuffer<VisibleArea> g_visibleArea;
+int g_game;
+std::vector<Command> g_commandLog;
+
+Scheduler& scheduler()
+{
+  static Scheduler instance;
+  return instance;
 }
 
-Circuit g_circuit;
+auto const PUMP_RAMP_TICKS = 250; // 5s
+auto const MAX_SECTIONS_PER_UNIT = 32; // per circuit
+auto const UNIT_SIZE = 16; // on the grid of units
+
+// Large plants keep the sections and connections on huge pages:
+// the solver streams through them every tick, and with 4K pages,
+// TLB misses show up in the profiles of large circuits.
+auto const HUGE_PAGE_UNITS = 256;
+
+void resetCircuit(Circuit& circuit, int units)
+{
+  auto const backing = units >= HUGE_PAGE_UNITS ? Backing::TransparentHugePages : Backing::Heap;
+
+  circuit = {};
+  circuit.sections = Array<Section>(StorageAllocator<Section>(backing));
+  circuit.connections = Array<Connection>(StorageAllocator<Connection>(backing));
+
+  // never reallocate, we take pointers on elements
+  circuit.sections.reserve(std::max(4096, units * MAX_SECTIONS_PER_UNIT));
+}
 
-void connect(Entity* a, Entity* b)
+void connect(Circuit& circuit, Entity* a, Entity* b)
 {
-  connectSections(g_circuit, *a->section, *b->section);
+  connectSections(circuit, *a->section, *b->section);
 }
 
-void connect(std::vector<Entity*> entities)
+void connect(Circuit& circuit, std::vector<Entity*> entities)
 {
   for(int i = 0; i + 1 < entities.size(); ++i)
-    connectSections(g_circuit, *entities[i]->section, *entities[i + 1]->section);
+    connectSections(circuit, *entities[i]->section, *entities[i + 1]->section);
 }
 
-struct EPipe : Entity
+struct EPipe final : Entity
 {
   bool selectable() const override { return false; }
-  std::vector<Sprite> sprite() const
+  Sprites sprite() const override
   {
     return {
       { "data/pipe.png" }
@@ -66,11 +142,10 @@ struct EPipe : Entity
   const char* name() const override { return "Water Pipe"; };
 };
 
-struct EReactor : Entity
+struct EReactor final : Entity
 {
-  void tick() override
+  void tick()
   {
-    section->T += 8.0 * controlRods;
     temperature = section->T;
 
     if(section->T > 300)
@@ -78,7 +153,7 @@ struct EReactor : Entity
   }
 
   Vec2f size() const override { return Vec2f(2, 4); }
-  std::vector<Sprite> sprite() const
+  Sprites sprite() const override
   {
     return {
       { "data/reactor.png" }
@@ -87,28 +162,21 @@ struct EReactor : Entity
 
   const char* name() const override { return "Reactor Core"; };
 
-  std::vector<Property> introspect() const override
+  PropertyTable introspect() const override;
+
+  void onPropertyChanged() override
   {
-    return {
-      Property{ "Control Rods", Type::Float, (void*)&controlRods },
-      Property{ "Temperature Reading", Type::Float, (void*)&temperature, true },
-    };
+    schedule(*circuit, { g_tick, &section->heating, 8.0f * controlRods });
   }
 
   float controlRods = 0;
   float temperature = 200.0;
 };
 
-struct ECoolingTower : Entity
+struct ECoolingTower final : Entity
 {
-  void tick() override
-  {
-    // heat dissipation
-    section->T = blend(0.99, section->T, 25);
-  }
-
   Vec2f size() const override { return Vec2f(2, 2); }
-  std::vector<Sprite> sprite() const
+  Sprites sprite() const override
   {
     return {
       { "data/coolingtower.png" }
@@ -116,16 +184,11 @@ struct ECoolingTower : Entity
   }
 
   const char* name() const override { return "Cooling Tower"; };
-
-  std::vector<Property> introspect() const override
-  {
-    return {};
-  }
 };
 
-struct ETurbine : Entity
+struct ETurbine final : Entity
 {
-  void tick() override
+  void tick()
   {
     if(section->T > 100)
       speed += (section->T - 100) * 0.01;
@@ -135,7 +198,7 @@ struct ETurbine : Entity
   }
 
   Vec2f size() const override { return Vec2f(2, 3); }
-  std::vector<Sprite> sprite() const
+  Sprites sprite() const override
   {
     return {
       { "data/turbine.png" }
@@ -144,21 +207,15 @@ struct ETurbine : Entity
 
   const char* name() const override { return "Steam Turbine"; };
 
-  std::vector<Property> introspect() const override
-  {
-    return {
-      Property{ "Angular Speed", Type::Float, (void*)&speed, true },
-      Property{ "Temperature Reading", Type::Float, (void*)&temperature, true },
-    };
-  }
+  PropertyTable introspect() const override;
 
   float speed = 0;
   float temperature = 0;
 };
 
-struct EGenerator : Entity
+struct EGenerator final : Entity
 {
-  void tick() override
+  void tick()
   {
     power = turbine->speed;
     totalEnergy += power * 0.001;
@@ -167,8 +224,10 @@ struct EGenerator : Entity
       g_finishMessage = "YOU WIN";
   }
 
+  static auto const STAGE = 1;
+
   Vec2f size() const override { return Vec2f(2, 1); }
-  std::vector<Sprite> sprite() const
+  Sprites sprite() const override
   {
     return {
       { "data/generator.png" }
@@ -177,32 +236,19 @@ struct EGenerator : Entity
 
   const char* name() const override { return "Power Generator"; };
 
-  std::vector<Property> introspect() const override
-  {
-    return {
-      Property{ "Power (MWe)", Type::Float, (void*)&power, true },
-      Property{ "Total Energy", Type::Float, (void*)&totalEnergy, true },
-    };
-  }
+  PropertyTable introspect() const override;
 
   ETurbine* turbine = nullptr;
   float power = 0;
   float totalEnergy = 0;
 };
 
-float randFloat()
+struct EPump final : Entity
 {
-  return rand() / float(RAND_MAX);
-}
-
-struct EPump : Entity
-{
-  void tick() override
+  void tick()
   {
-    float flux = enable ? powerRatio * fullPower : 0;
-
     // +/- 20%
-    flux *= 1.0f + randFloat() * 0.4 - 0.2;
+    const float flux = nominalFlux * (1.0f + randomFloat(randomKey(g_seed, id), g_tick) * 0.4 - 0.2);
 
     section->selfFlux = flux;
 
@@ -212,7 +258,7 @@ struct EPump : Entity
       angle -= TAU;
   }
 
-  std::vector<Sprite> sprite() const
+  Sprites sprite() const override
   {
     return {
       { "data/pump.png" }, { "data/pump2.png", -angle }
@@ -220,28 +266,27 @@ struct EPump : Entity
   }
 
   const char* name() const override { return "Water Pump"; };
-  std::vector<Property> introspect() const override
+  PropertyTable introspect() const override;
+
+  void onPropertyChanged() override
   {
-    return {
-      Property{ "Enable", Type::Bool, (void*)&enable },
-      Property{ "Power", Type::Float, (void*)&powerRatio },
-    };
+    const float target = enable ? powerRatio * fullPower : 0;
+
+    // the initial settings apply at once
+    const int duration = g_tick == 0 ? 0 : PUMP_RAMP_TICKS;
+    schedule(*circuit, { g_tick, &nominalFlux, target, duration });
   }
 
   bool enable = true;
   float powerRatio = 0.5;
   float angle = 0;
+  float nominalFlux = 0; // ramped towards powerRatio * fullPower
   const float fullPower = 30.0;
 };
 
-struct EManometer : Entity
+struct EManometer final : Entity
 {
-  void tick() override
-  {
-    pressure = blend(0.1, pressure, section->P);
-  }
-
-  std::vector<Sprite> sprite() const override
+  Sprites sprite() const override
   {
     auto angle = clamp(pressure * 0.01, 0.1, TAU - 0.1);
     return {
@@ -250,24 +295,14 @@ struct EManometer : Entity
   }
 
   const char* name() const override { return "Pressure Manometer"; };
-  std::vector<Property> introspect() const override
-  {
-    return {
-      Property{ "Pressure Reading", Type::Float, (void*)&pressure, true },
-    };
-  }
+  PropertyTable introspect() const override;
 
-  float pressure = 0.0;
+  float pressure = 0.0; // from g_sensors
 };
 
-struct EHeatSink : Entity
+struct EHeatSink final : Entity
 {
-  void tick() override
-  {
-    temperature = section->T;
-  }
-
-  std::vector<Sprite> sprite() const override
+  Sprites sprite() const override
   {
     return {
       { "data/heatsink.png" }
@@ -275,28 +310,22 @@ struct EHeatSink : Entity
   }
 
   const char* name() const override { return "Temperature Sensor"; };
-  std::vector<Property> introspect() const override
-  {
-    return {
-      Property{ "Temperature Reading", Type::Float, (void*)&temperature, true },
-    };
-  }
+  PropertyTable introspect() const override;
 
-  float temperature = 0;
+  float temperature = 0; // from g_sensors
 };
 
-struct EFlowMeter : Entity
+struct EFlowMeter final : Entity
 {
-  void tick() override
+  void tick()
   {
-    flow = blend(0.1, flow, section->flux0);
     phase += flow * 0.005;
 
     if(phase > TAU)
       phase -= TAU;
   }
 
-  std::vector<Sprite> sprite() const override
+  Sprites sprite() const override
   {
     return {
       { "data/flowmeter.png" }, { "data/flowmeter_pin.png", -phase }
@@ -304,35 +333,17 @@ struct EFlowMeter : Entity
   }
 
   const char* name() const override { return "Flow Meter"; };
-  std::vector<Property> introspect() const override
-  {
-    return {
-      Property{ "Flow Reading", Type::Float, (void*)&flow, true },
-    };
-  }
+  PropertyTable introspect() const override;
 
-  float flow = 0;
+  float flow = 0; // from g_sensors
   float phase = 0;
 };
 
-struct EHeatExchanger : Entity
+struct EHeatExchanger final : Entity
 {
-  void tick() override
-  {
-    if(other)
-    {
-      double delta = other->section->T - section->T;
-      delta *= 0.4;
-      other->section->T -= delta;
-      section->T += delta;
-    }
-
-    temperature = section->T;
-  }
-
   Vec2f size() const override { return Vec2f(2, 1); }
 
-  std::vector<Sprite> sprite() const override
+  Sprites sprite() const override
   {
     return {
       { "data/heatexchanger.png" }
@@ -340,25 +351,14 @@ struct EHeatExchanger : Entity
   }
 
   const char* name() const override { return "Heat Exchanger"; };
-  std::vector<Property> introspect() const override
-  {
-    return {
-      Property{ "Temperature Reading", Type::Float, (void*)&temperature, true },
-    };
-  }
+  PropertyTable introspect() const override;
 
-  EHeatExchanger* other = nullptr;
-  float temperature = 0.0;
+  float temperature = 0; // from g_sensors
 };
 
-struct EValve : Entity
+struct EValve final : Entity
 {
-  void tick() override
-  {
-    section->damping = open;
-  }
-
-  std::vector<Sprite> sprite() const override
+  Sprites sprite() const override
   {
     return {
       { "data/valve.png", open* -8.0f }
@@ -366,85 +366,442 @@ struct EValve : Entity
   }
 
   const char* name() const override { return "Valve"; };
-  std::vector<Property> introspect() const override
+  PropertyTable introspect() const override;
+
+  void onPropertyChanged() override
   {
-    return {
-      Property{ "Opening ratio", Type::Float, (void*)&open },
-    };
+    schedule(*circuit, { g_tick, &section->damping, open });
   }
 
   float open = 1.0;
 };
 
+///////////////////////////////////////////////////////////////////////////////
+// Property tables: name, type, member, read-only, unit, range of the setting
+
+// &T::value as a member of Actor, which the tables can hold for any type
+template<typename T, typename Value>
+constexpr Value Actor::* member(Value T::* value)
+{
+  return static_cast<Value Actor::*>(value);
+}
+
+constexpr Property REACTOR_PROPERTIES[] =
+{
+  { "Control Rods", Type::Float, member(&EReactor::controlRods), false, "", 0, 1 },
+  { "Temperature Reading", Type::Float, member(&EReactor::temperature), true, "C" },
+};
+
+constexpr Property TURBINE_PROPERTIES[] =
+{
+  { "Angular Speed", Type::Float, member(&ETurbine::speed), true },
+  { "Temperature Reading", Type::Float, member(&ETurbine::temperature), true, "C" },
+};
+
+constexpr Property GENERATOR_PROPERTIES[] =
+{
+  { "Power", Type::Float, member(&EGenerator::power), true, "MWe" },
+  { "Total Energy", Type::Float, member(&EGenerator::totalEnergy), true },
+};
+
+constexpr Property PUMP_PROPERTIES[] =
+{
+  { "Enable", Type::Bool, member(&EPump::enable) },
+  { "Power", Type::Float, member(&EPump::powerRatio), false, "", 0, 1 },
+};
+
+constexpr Property MANOMETER_PROPERTIES[] =
+{
+  { "Pressure Reading", Type::Float, member(&EManometer::pressure), true },
+};
+
+constexpr Property HEAT_SINK_PROPERTIES[] =
+{
+  { "Temperature Reading", Type::Float, member(&EHeatSink::temperature), true, "C" },
+};
+
+constexpr Property FLOW_METER_PROPERTIES[] =
+{
+  { "Flow Reading", Type::Float, member(&EFlowMeter::flow), true },
+};
+
+constexpr Property HEAT_EXCHANGER_PROPERTIES[] =
+{
+  { "Temperature Reading", Type::Float, member(&EHeatExchanger::temperature), true, "C" },
+};
+
+constexpr Property VALVE_PROPERTIES[] =
+{
+  { "Opening ratio", Type::Float, member(&EValve::open), false, "", 0, 1 },
+};
+
+PropertyTable EReactor::introspect() const { return REACTOR_PROPERTIES; }
+PropertyTable ETurbine::introspect() const { return TURBINE_PROPERTIES; }
+PropertyTable EGenerator::introspect() const { return GENERATOR_PROPERTIES; }
+PropertyTable EPump::introspect() const { return PUMP_PROPERTIES; }
+PropertyTable EManometer::introspect() const { return MANOMETER_PROPERTIES; }
+PropertyTable EHeatSink::introspect() const { return HEAT_SINK_PROPERTIES; }
+PropertyTable EFlowMeter::introspect() const { return FLOW_METER_PROPERTIES; }
+PropertyTable EHeatExchanger::introspect() const { return HEAT_EXCHANGER_PROPERTIES; }
+PropertyTable EValve::introspect() const { return VALVE_PROPERTIES; }
+
+// one 'Container<T>' per entity type
+template<template<typename> class Container>
+using PerEntityType = std::tuple<
+  Container<EPipe>,
+  Container<EReactor>,
+  Container<ECoolingTower>,
+  Container<ETurbine>,
+  Container<EGenerator>,
+  Container<EPump>,
+  Container<EManometer>,
+  Container<EHeatSink>,
+  Container<EFlowMeter>,
+  Container<EHeatExchanger>,
+  Container<EValve>
+  >;
+
+PerEntityType<Pool> g_pools;
+
+// instruments register their sensor on spawn
+template<typename T>
+void attachSensor(T&) {}
+
+void attachSensor(EManometer& e) { g_sensors.add(*e.section, Quantity::Pressure, &e.pressure, 0.1); }
+void attachSensor(EFlowMeter& e) { g_sensors.add(*e.section, Quantity::Flux, &e.flow, 0.1); }
+void attachSensor(EHeatSink& e) { g_sensors.add(*e.section, Quantity::Temperature, &e.temperature); }
+void attachSensor(EHeatExchanger& e) { g_sensors.add(*e.section, Quantity::Temperature, &e.temperature); }
+
+// Constructs 'count' entities in place, each with its own new section.
+// The circuit must have enough capacity reserved, as entities
+// keep pointers to their section.
+template<typename T>
+View<T> SpawnMany(Circuit& circuit, int count)
+{
+  auto entities = std::get<Pool<T>>(g_pools).allocate(count);
+
+  auto& sections = circuit.sections;
+  assert(sections.size() + count <= sections.capacity());
+  auto const firstSection = sections.size();
+  sections.resize(firstSection + count);
+
+  for(int i = 0; i < count; ++i)
+  {
+    auto& entity = entities[i];
+    entity.circuit = &circuit;
+    entity.section = &sections[firstSection + i];
+    entity.section->mass = 1000; // put some water
+    entity.section->T = 25; // room temperature
+    attachSensor(entity);
+    g_entities.push_back(&entity);
+  }
+
+  return entities;
+}
+
+template<typename T>
+T* Spawn(Circuit& circuit)
+{
+  return &SpawnMany<T>(circuit, 1)[0];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Prefabs: a unit is built once by code, captured, then replicated
+// by block copies of its entities, sections and connections.
+
+template<typename T>
+struct PrefabEntities
+{
+  std::vector<T> entities; // pointers still refer to the captured unit
+  std::vector<const T*> sources; // captured entities
+  std::vector<int> parts; // circuit part of each entity
+  std::vector<int> sections; // index of each entity's section, in its part
+  std::vector<int> links; // index of a linked entity, -1 if none
+};
+
+struct Prefab
+{
+  static auto const MAX_PARTS = 2;
+
+  // what the unit added to one circuit
+  struct Part
+  {
+    Circuit* circuit;
+    int firstSection; // in the captured unit
+    std::vector<Section> sections;
+    std::vector<std::array<int, 2>> connections; // indices in 'sections'
+  };
+
+  struct ThermalLink
+  {
+    int owner; // part holding the link
+    int parts[2];
+    int sections[2];
+    float conductance;
+  };
+
+  Part parts[MAX_PARTS];
+  std::vector<ThermalLink> thermalLinks;
+  PerEntityType<PrefabEntities> entities;
+};
+
+// where a unit starts
+struct PrefabMark
+{
+  Circuit* circuits[Prefab::MAX_PARTS];
+  int entities;
+  int sections[Prefab::MAX_PARTS];
+  int connections[Prefab::MAX_PARTS];
+  int thermalLinks[Prefab::MAX_PARTS];
+};
+
+PrefabMark markPrefab(Circuit& a, Circuit& b)
+{
+  PrefabMark mark {};
+  mark.circuits[0] = &a;
+  mark.circuits[1] = &b;
+  mark.entities = g_entities.size();
+
+  for(int p = 0; p < Prefab::MAX_PARTS; ++p)
+  {
+    mark.sections[p] = mark.circuits[p]->sections.size();
+    mark.connections[p] = mark.circuits[p]->connections.size();
+    mark.thermalLinks[p] = mark.circuits[p]->thermalLinks.size();
+  }
+
+  return mark;
+}
+
+// entities referring to other entities
 template<typename T>
-T* Spawn(std::unique_ptr<T> entity)
+int captureLink(const T&, const Prefab&) { return -1; }
+
+int captureLink(const EGenerator& generator, const Prefab& prefab)
+{
+  auto& turbines = std::get<PrefabEntities<ETurbine>>(prefab.entities).sources;
+  return std::find(turbines.begin(), turbines.end(), generator.turbine) - turbines.begin();
+}
+
+template<typename T, typename Instances>
+void rebaseLink(T&, int, const Instances&) {}
+
+template<typename Instances>
+void rebaseLink(EGenerator& generator, int link, const Instances& instances)
 {
-  T* r = entity.get();
-  g_circuit.sections.push_back({});
-  entity->section = &g_circuit.sections.back();
-  entity->section->mass = 1000; // put some water
-  entity->section->T = 25; // room temperature
-  g_entities.push_back(std::move(entity));
-  return r;
+  generator.turbine = &std::get<View<ETurbine>>(instances)[link];
+}
+
+// everything built since 'mark'
+Prefab capturePrefab(const PrefabMark& mark)
+{
+  Prefab prefab;
+
+  // part and index of a section of the unit
+  auto locate = [&] (const Section* section, int& part, int& index)
+    {
+      for(part = 0; part < Prefab::MAX_PARTS; ++part)
+      {
+        auto& sections = mark.circuits[part]->sections;
+        index = section - sections.data() - mark.sections[part];
+
+        if(index >= 0 && index < (int)sections.size() - mark.sections[part])
+          return;
+      }
+
+      assert(0 && "section outside of the unit");
+    };
+
+  for(int p = 0; p < Prefab::MAX_PARTS; ++p)
+  {
+    auto& circuit = *mark.circuits[p];
+    auto& part = prefab.parts[p];
+    part.circuit = &circuit;
+    part.firstSection = mark.sections[p];
+    part.sections.assign(circuit.sections.begin() + mark.sections[p], circuit.sections.end());
+
+    for(int i = mark.connections[p]; i < (int)circuit.connections.size(); ++i)
+    {
+      auto& connection = circuit.connections[i];
+      int parts[2], sections[2];
+      locate(connection.sections[0], parts[0], sections[0]);
+      locate(connection.sections[1], parts[1], sections[1]);
+      assert(parts[0] == p && parts[1] == p);
+      part.connections.push_back({ sections[0], sections[1] });
+    }
+
+    for(int i = mark.thermalLinks[p]; i < (int)circuit.thermalLinks.size(); ++i)
+    {
+      auto& link = circuit.thermalLinks[i];
+      Prefab::ThermalLink captured {};
+      captured.owner = p;
+      captured.conductance = link.conductance;
+      locate(link.sections[0], captured.parts[0], captured.sections[0]);
+      locate(link.sections[1], captured.parts[1], captured.sections[1]);
+      prefab.thermalLinks.push_back(captured);
+    }
+  }
+
+  auto captureEntities = [&] (auto& captured)
+    {
+      using T = typename std::remove_reference<decltype(captured.entities)>::type::value_type;
+
+      for(int i = mark.entities; i < (int)g_entities.size(); ++i)
+      {
+        auto entity = dynamic_cast<const T*>(g_entities[i]);
+
+        if(!entity)
+          continue;
+
+        int part, section;
+        locate(entity->section, part, section);
+        captured.entities.push_back(*entity);
+        captured.sources.push_back(entity);
+        captured.parts.push_back(part);
+        captured.sections.push_back(section);
+        captured.links.push_back(captureLink(*entity, prefab));
+      }
+    };
+
+  std::apply([&] (auto& ... captured) { (captureEntities(captured), ...); }, prefab.entities);
+
+  return prefab;
 }
 
-void buildPrimaryCircuit(EHeatExchanger* HeatExchanger)
+// Replicates a unit, moved by 'offset', its ids prefixed by 'prefix'.
+// The circuits must have enough capacity reserved.
+// Returns the new entities, by type.
+PerEntityType<View> instantiatePrefab(const Prefab& prefab, Vec2f offset, const char* prefix)
 {
-  auto MainPrimary = Spawn(std::make_unique<EPipe>());
+  Section* bases[Prefab::MAX_PARTS];
+
+  for(int p = 0; p < Prefab::MAX_PARTS; ++p)
+  {
+    auto& part = prefab.parts[p];
+    auto& sections = part.circuit->sections;
+    assert(sections.size() + part.sections.size() <= sections.capacity());
+    auto const first = sections.size();
+    sections.insert(sections.end(), part.sections.begin(), part.sections.end());
+    bases[p] = sections.data() + first;
+
+    for(auto& connection : part.connections)
+      connectSections(*part.circuit, bases[p][connection[0]], bases[p][connection[1]]);
+  }
+
+  for(auto& link : prefab.thermalLinks)
+  {
+    auto& a = bases[link.parts[0]][link.sections[0]];
+    auto& b = bases[link.parts[1]][link.sections[1]];
+    connectThermal(*prefab.parts[link.owner].circuit, a, b, link.conductance);
+  }
+
+  PerEntityType<View> instances;
+
+  char id[256];
+  auto const prefixLength = strlen(prefix);
+  assert(prefixLength < sizeof id);
+  memcpy(id, prefix, prefixLength);
+
+  auto copyEntities = [&] (auto& captured, auto& instance)
+    {
+      using T = typename std::remove_reference<decltype(captured.entities)>::type::value_type;
+
+      instance = std::get<Pool<T>>(g_pools).allocate(captured.entities.data(), captured.entities.size());
+
+      for(int i = 0; i < instance.size(); ++i)
+      {
+        auto& entity = instance[i];
+        entity.section = &bases[captured.parts[i]][captured.sections[i]];
+        entity.pos = entity.pos + offset;
+
+        if(entity.id >= 0)
+        {
+          auto const name = g_ids.get(entity.id);
+          auto const nameLength = strlen(name);
+          assert(prefixLength + nameLength < sizeof id);
+          memcpy(id + prefixLength, name, nameLength + 1);
+          entity.id = g_ids.intern(id);
+        }
+
+        attachSensor(entity);
+        g_entities.push_back(&entity);
+      }
+    };
+
+  auto rebaseLinks = [&] (auto& captured, auto& instance)
+    {
+      for(int i = 0; i < instance.size(); ++i)
+        rebaseLink(instance[i], captured.links[i], instances);
+    };
+
+  std::apply([&] (auto& ... captured)
+    {
+      std::apply([&] (auto& ... instance)
+        {
+          (copyEntities(captured, instance), ...);
+          (rebaseLinks(captured, instance), ...);
+        }, instances);
+    }, prefab.entities);
+
+  return instances;
+}
+
+void buildPrimaryCircuit(Circuit& circuit, EHeatExchanger* HeatExchanger)
+{
+  auto MainPrimary = Spawn<EPipe>(circuit);
   MainPrimary->angle = PI;
 
-  auto Pipe1 = Spawn(std::make_unique<EPipe>());
+  auto Pipe1 = Spawn<EPipe>(circuit);
   Pipe1->angle = PI;
-  auto Pipe2 = Spawn(std::make_unique<EPipe>());
+  auto Pipe2 = Spawn<EPipe>(circuit);
   Pipe2->angle = PI;
-  auto Pipe3 = Spawn(std::make_unique<EPipe>());
+  auto Pipe3 = Spawn<EPipe>(circuit);
   Pipe3->angle = PI;
-  auto Pipe4 = Spawn(std::make_unique<EPipe>());
+  auto Pipe4 = Spawn<EPipe>(circuit);
   Pipe4->angle = PI;
 
-  auto FlowMeter = Spawn(std::make_unique<EFlowMeter>());
-  FlowMeter->id = "[Primary Circuit] Flow Meter";
+  auto FlowMeter = Spawn<EFlowMeter>(circuit);
+  FlowMeter->id = g_ids.intern("[Primary Circuit] Flow Meter");
   FlowMeter->angle = PI;
 
-  auto ColdPressure = Spawn(std::make_unique<EManometer>());
-  ColdPressure->id = "[Primary Circuit] Cold Pressure";
+  auto ColdPressure = Spawn<EManometer>(circuit);
+  ColdPressure->id = g_ids.intern("[Primary Circuit] Cold Pressure");
   ColdPressure->angle = PI;
 
-  auto PreValve1 = Spawn(std::make_unique<EValve>());
-  PreValve1->id = "[Primary Circuit] Main Pre-Valve 1";
+  auto PreValve1 = Spawn<EValve>(circuit);
+  PreValve1->id = g_ids.intern("[Primary Circuit] Main Pre-Valve 1");
 
-  auto PreValve2 = Spawn(std::make_unique<EValve>());
-  PreValve2->id = "[Primary Circuit] Main Pre-Valve 2";
+  auto PreValve2 = Spawn<EValve>(circuit);
+  PreValve2->id = g_ids.intern("[Primary Circuit] Main Pre-Valve 2");
 
-  auto Pump1 = Spawn(std::make_unique<EPump>());
-  Pump1->id = "[Primary Circuit] Pump 1";
+  auto Pump1 = Spawn<EPump>(circuit);
+  Pump1->id = g_ids.intern("[Primary Circuit] Pump 1");
   Pump1->powerRatio = 0.04;
 
-  auto Pump2 = Spawn(std::make_unique<EPump>());
-  Pump2->id = "[Primary Circuit] Pump 2";
+  auto Pump2 = Spawn<EPump>(circuit);
+  Pump2->id = g_ids.intern("[Primary Circuit] Pump 2");
   Pump2->powerRatio = 0.1;
 
-  auto PostValve1 = Spawn(std::make_unique<EValve>());
-  PostValve1->id = "[Primary Circuit] Main Post-Valve 1";
+  auto PostValve1 = Spawn<EValve>(circuit);
+  PostValve1->id = g_ids.intern("[Primary Circuit] Main Post-Valve 1");
 
-  auto PostValve2 = Spawn(std::make_unique<EValve>());
-  PostValve2->id = "[Primary Circuit] Main Post-Valve 2";
+  auto PostValve2 = Spawn<EValve>(circuit);
+  PostValve2->id = g_ids.intern("[Primary Circuit] Main Post-Valve 2");
 
-  auto ColdHeatSensor = Spawn(std::make_unique<EHeatSink>());
-  ColdHeatSensor->id = "[Primary Circuit] Cold Heat Sensor";
+  auto ColdHeatSensor = Spawn<EHeatSink>(circuit);
+  ColdHeatSensor->id = g_ids.intern("[Primary Circuit] Cold Heat Sensor");
 
-  auto ReactorCore = Spawn(std::make_unique<EReactor>());
-  ReactorCore->id = "Reactor Core";
+  auto ReactorCore = Spawn<EReactor>(circuit);
+  ReactorCore->id = g_ids.intern("Reactor Core");
   ReactorCore->controlRods = 0;
 
-  auto HotHeatSensor = Spawn(std::make_unique<EHeatSink>());
-  HotHeatSensor->id = "[Primary Circuit] Hot Heat Sensor";
+  auto HotHeatSensor = Spawn<EHeatSink>(circuit);
+  HotHeatSensor->id = g_ids.intern("[Primary Circuit] Hot Heat Sensor");
 
-  auto HotPressure = Spawn(std::make_unique<EManometer>());
-  HotPressure->id = "[Primary Circuit] Hot Pressure";
+  auto HotPressure = Spawn<EManometer>(circuit);
+  HotPressure->id = g_ids.intern("[Primary Circuit] Hot Pressure");
 
-  auto HotFlow = Spawn(std::make_unique<EFlowMeter>());
-  HotFlow->id = "[Primary Circuit] Hot Flow";
+  auto HotFlow = Spawn<EFlowMeter>(circuit);
+  HotFlow->id = g_ids.intern("[Primary Circuit] Hot Flow");
 
   // --------------------------------------
 
@@ -471,7 +828,7 @@ void buildPrimaryCircuit(EHeatExchanger* HeatExchanger)
 
   // --------------------------------------
 
-  connect({
+  connect(circuit, {
       MainPrimary,
       FlowMeter,
       ColdPressure,
@@ -491,7 +848,7 @@ void buildPrimaryCircuit(EHeatExchanger* HeatExchanger)
       MainPrimary });
 
   // redundant pump
-  connect({
+  connect(circuit, {
       ColdPressure,
       PreValve2,
       Pump2,
@@ -500,56 +857,57 @@ void buildPrimaryCircuit(EHeatExchanger* HeatExchanger)
     });
 }
 
-void buildSecondaryCircuit(EHeatExchanger* HeatExchanger)
+void buildSecondaryCircuit(Circuit& circuit, EHeatExchanger* HeatExchanger)
 {
-  auto CoolingTower = Spawn(std::make_unique<ECoolingTower>());
-  CoolingTower->id = "Cooling Tower";
+  auto CoolingTower = Spawn<ECoolingTower>(circuit);
+  CoolingTower->id = g_ids.intern("Cooling Tower");
   CoolingTower->angle = PI;
+  CoolingTower->section->cooling = 0.99; // heat dissipation
 
-  auto Turbine = Spawn(std::make_unique<ETurbine>());
-  Turbine->id = "Turbine #1";
+  auto Turbine = Spawn<ETurbine>(circuit);
+  Turbine->id = g_ids.intern("Turbine #1");
   Turbine->angle = PI;
 
-  auto Generator = Spawn(std::make_unique<EGenerator>());
+  auto Generator = Spawn<EGenerator>(circuit);
   Generator->turbine = Turbine;
-  Generator->id = "Power Generator";
+  Generator->id = g_ids.intern("Power Generator");
 
-  auto FlowMeter = Spawn(std::make_unique<EFlowMeter>());
-  FlowMeter->id = "[Secondary Circuit] Flow Meter";
+  auto FlowMeter = Spawn<EFlowMeter>(circuit);
+  FlowMeter->id = g_ids.intern("[Secondary Circuit] Flow Meter");
   FlowMeter->angle = PI;
 
-  auto ColdPressure = Spawn(std::make_unique<EManometer>());
-  ColdPressure->id = "[Secondary Circuit] Cold Pressure";
+  auto ColdPressure = Spawn<EManometer>(circuit);
+  ColdPressure->id = g_ids.intern("[Secondary Circuit] Cold Pressure");
   ColdPressure->angle = PI;
 
-  auto PreValve1 = Spawn(std::make_unique<EValve>());
-  PreValve1->id = "[Secondary Circuit] Main Pre-Valve 1";
+  auto PreValve1 = Spawn<EValve>(circuit);
+  PreValve1->id = g_ids.intern("[Secondary Circuit] Main Pre-Valve 1");
 
-  auto PreValve2 = Spawn(std::make_unique<EValve>());
-  PreValve2->id = "[Secondary Circuit] Main Pre-Valve 2";
+  auto PreValve2 = Spawn<EValve>(circuit);
+  PreValve2->id = g_ids.intern("[Secondary Circuit] Main Pre-Valve 2");
 
-  auto Pump1 = Spawn(std::make_unique<EPump>());
-  Pump1->id = "[Secondary Circuit] Pump 1";
+  auto Pump1 = Spawn<EPump>(circuit);
+  Pump1->id = g_ids.intern("[Secondary Circuit] Pump 1");
   Pump1->powerRatio = 0.3;
 
-  auto Pump2 = Spawn(std::make_unique<EPump>());
-  Pump2->id = "[Secondary Circuit] Pump 2";
+  auto Pump2 = Spawn<EPump>(circuit);
+  Pump2->id = g_ids.intern("[Secondary Circuit] Pump 2");
   Pump2->powerRatio = 0.6;
 
-  auto PostValve1 = Spawn(std::make_unique<EValve>());
-  PostValve1->id = "[Secondary Circuit] Main Post-Valve 1";
+  auto PostValve1 = Spawn<EValve>(circuit);
+  PostValve1->id = g_ids.intern("[Secondary Circuit] Main Post-Valve 1");
 
-  auto PostValve2 = Spawn(std::make_unique<EValve>());
-  PostValve2->id = "[Secondary Circuit] Main Post-Valve 2";
+  auto PostValve2 = Spawn<EValve>(circuit);
+  PostValve2->id = g_ids.intern("[Secondary Circuit] Main Post-Valve 2");
 
-  auto ColdHeatSensor = Spawn(std::make_unique<EHeatSink>());
-  ColdHeatSensor->id = "[Secondary Circuit] Cold Heat Sensor";
+  auto ColdHeatSensor = Spawn<EHeatSink>(circuit);
+  ColdHeatSensor->id = g_ids.intern("[Secondary Circuit] Cold Heat Sensor");
 
-  auto HotHeatSensor = Spawn(std::make_unique<EHeatSink>());
-  HotHeatSensor->id = "[Secondary Circuit] Hot Heat Sensor";
+  auto HotHeatSensor = Spawn<EHeatSink>(circuit);
+  HotHeatSensor->id = g_ids.intern("[Secondary Circuit] Hot Heat Sensor");
 
-  auto HotPressure = Spawn(std::make_unique<EManometer>());
-  HotPressure->id = "[Secondary Circuit] Hot Pressure";
+  auto HotPressure = Spawn<EManometer>(circuit);
+  HotPressure->id = g_ids.intern("[Secondary Circuit] Hot Pressure");
 
   // --------------------------------------
 
@@ -573,21 +931,21 @@ void buildSecondaryCircuit(EHeatExchanger* HeatExchanger)
 
   // --------------------------------------
 
-  connect({ Turbine,
-            CoolingTower,
-            FlowMeter,
-            ColdPressure,
-            PreValve1,
-            Pump1,
-            PostValve1,
-            ColdHeatSensor,
-            HeatExchanger,
-            HotHeatSensor,
-            HotPressure,
-            Turbine });
+  connect(circuit, { Turbine,
+                     CoolingTower,
+                     FlowMeter,
+                     ColdPressure,
+                     PreValve1,
+                     Pump1,
+                     PostValve1,
+                     ColdHeatSensor,
+                     HeatExchanger,
+                     HotHeatSensor,
+                     HotPressure,
+                     Turbine });
 
   // redundant pump
-  connect({
+  connect(circuit, {
       ColdPressure,
       PreValve2,
       Pump2,
@@ -595,50 +953,291 @@ void buildSecondaryCircuit(EHeatExchanger* HeatExchanger)
       ColdHeatSensor,
     });
 }
+
+void apply(const Command& cmd)
+{
+  if(cmd.actor < 0 || cmd.actor >= (int)g_entities.size())
+    return;
+
+  auto& entity = *g_entities[cmd.actor];
+  auto props = entity.introspect();
+
+  if(cmd.property < 0 || cmd.property >= props.size() || props[cmd.property].readOnly)
+    return;
+
+  auto& prop = props[cmd.property];
+
+  switch(cmd.kind)
+  {
+  case Command::SetFloat:
+    assert(prop.type == Type::Float);
+    entity.*prop.member.asFloat = clamp(cmd.floatValue, prop.min, prop.max);
+    break;
+  case Command::SetBool:
+    assert(prop.type == Type::Bool);
+    entity.*prop.member.asBool = cmd.boolValue;
+    break;
+  }
+
+  entity.onPropertyChanged();
 }
 
-std::vector<Actor*> GameGetActors()
+void applyCommands()
 {
-  std::vector<Actor*> r;
-  r.reserve(g_entities.size());
+  Command cmd;
 
-  for(auto& entity : g_entities)
-    r.push_back(entity.get());
+  while(g_commands.pop(cmd))
+  {
+    cmd.tick = g_tick;
+    apply(cmd);
+    g_commandLog.push_back(cmd);
+  }
+}
+
+bool isVisible(const Actor& actor, const VisibleArea& area)
+{
+  auto const end = actor.pos + actor.size();
+  return end.x >= area.min.x && actor.pos.x < area.max.x && end.y >= area.min.y && actor.pos.y < area.max.y;
+}
+
+// The static part of the actor states is only written to each buffer
+// once per game, the rest only for the actors being looked at.
+void publish()
+{
+  auto& state = g_published.back();
+  auto const fresh = state.game != g_game;
+  state.game = g_game;
+  state.tick = g_tick;
+  state.finishMessage = g_finishMessage;
+  state.actors.resize(g_entities.size());
+
+  g_visibleArea.update();
+  auto& area = g_visibleArea.front();
+  auto const everything = fresh || area.game != g_game;
+
+  for(int i = 0; i < (int)g_entities.size(); ++i)
+  {
+    auto& entity = *g_entities[i];
+    auto& actor = state.actors[i];
+
+    if(fresh)
+    {
+      auto props = entity.introspect();
+      actor.actor = &entity;
+      actor.propertyCount = std::min<int>(props.size(), Actor::MAX_PROPERTIES);
+
+      for(int k = 0; k < actor.propertyCount; ++k)
+        actor.properties[k].info = &props[k];
+    }
+
+    if(!everything && i != area.selection && !isVisible(entity, area))
+      continue;
+
+    actor.mass = entity.mass();
+    actor.temperature = entity.temperature();
+    actor.pressure = entity.pressure();
+    actor.flux0 = entity.flux0();
+
+    actor.sprites = entity.sprite();
+
+    for(int k = 0; k < actor.propertyCount; ++k)
+    {
+      auto& prop = actor.properties[k];
+
+      switch(prop.info->type)
+      {
+      case Type::Float:
+        prop.value = entity.*prop.info->member.asFloat;
+        break;
+      case Type::Bool:
+        prop.value = entity.*prop.info->member.asBool;
+        break;
+      }
+    }
+  }
+
+  g_published.publish();
+}
+
+// solver phases, then entities of each circuit, chunked, then publication
+void buildTickGraph()
+{
+  auto const CHUNK_SIZE = 256;
+  auto const SENSOR_CHUNK_SIZE = 4096;
+
+  g_tickGraph = {};
+
+  auto advanceSecondary = g_tickGraph.add([] () { advance(g_secondary, g_tick); });
+  auto advancePrimary = g_tickGraph.add([] () { advance(g_primary, g_tick); });
+  auto exchange = g_tickGraph.add([] ()
+    {
+      exchangeHeat(g_primary, g_tick);
+      exchangeHeat(g_secondary, g_tick);
+    }, { advanceSecondary, advancePrimary });
+
+  std::vector<TaskGraph::Task> sensorTasks;
+
+  for(int i = 0; i < g_sensors.size(); i += SENSOR_CHUNK_SIZE)
+  {
+    int const begin = i;
+    int const end = std::min(i + SENSOR_CHUNK_SIZE, g_sensors.size());
+    sensorTasks.push_back(g_tickGraph.add([begin, end] () { g_sensors.update(g_tick, begin, end); }, { exchange }));
+  }
+
+  if(sensorTasks.empty())
+    sensorTasks = { exchange };
+
+  std::vector<TaskGraph::Task> entityTasks[2];
+
+  // one batch of tasks per entity type, for the types having a tick
+  auto addPool = [&] (int stage, auto& pool)
+    {
+      using T = typename std::remove_reference<decltype(pool)>::type::value_type;
+
+      if(std::is_same<decltype(&T::tick), decltype(&Entity::tick)>::value || T::STAGE != stage)
+        return;
+
+      auto& tasks = entityTasks[stage];
+      auto deps = stage == 0 || entityTasks[0].empty() ? sensorTasks : entityTasks[0];
+
+      for(auto& block : pool.blocks)
+      {
+        for(int i = 0; i < block.size(); i += CHUNK_SIZE)
+        {
+          T* const begin = block.begin() + i;
+          T* const end = block.begin() + std::min<int>(i + CHUNK_SIZE, block.size());
+          tasks.push_back(g_tickGraph.add([begin, end] ()
+            {
+              for(auto entity = begin; entity != end; ++entity)
+                entity->tick();
+            }, deps));
+        }
+      }
+    };
+
+  for(int stage = 0; stage < 2; ++stage)
+    std::apply([&] (auto& ... pools) { (addPool(stage, pools), ...); }, g_pools);
 
-  return r;
+  auto all = entityTasks[0];
+  all.insert(all.end(), entityTasks[1].begin(), entityTasks[1].end());
+  all.insert(all.end(), sensorTasks.begin(), sensorTasks.end());
+  g_tickGraph.add([] () { publish(); }, all);
+}
+}
+
+View<Actor* const> GameGetActors()
+{
+  return { g_entities.data(), g_entities.data() + g_entities.size() };
 }
 
 void GameInit()
+{
+  GameInitPlant(1, 0);
+}
+
+void GameInitPlant(int units, unsigned seed)
 {
   g_finishMessage = nullptr;
   g_entities.clear();
-  g_circuit = {};
-  // never reallocate, we take pointers on elements
-  g_circuit.sections.reserve(4096);
-
-  auto PrimaryHeatExchanger = Spawn(std::make_unique<EHeatExchanger>());
-  PrimaryHeatExchanger->id = "Primary Heat Exchanger";
+  g_pools = {};
+  g_ids.clear();
+  g_sensors.clear();
+  g_tick = 0;
+  ++g_game;
+  g_seed = seed;
+  resetCircuit(g_primary, units);
+  resetCircuit(g_secondary, units);
+
+  // the cooling side reacts slowly, no need to update it every tick
+  g_secondary.period = 2;
+
+  auto const unitStart = markPrefab(g_primary, g_secondary);
+
+  auto PrimaryHeatExchanger = Spawn<EHeatExchanger>(g_primary);
+  PrimaryHeatExchanger->id = g_ids.intern("Primary Heat Exchanger");
   PrimaryHeatExchanger->angle = PI;
 
-  auto SecondaryHeatExchanger = Spawn(std::make_unique<EHeatExchanger>());
-  SecondaryHeatExchanger->id = "Secondary Heat Exchanger";
+  auto SecondaryHeatExchanger = Spawn<EHeatExchanger>(g_secondary);
+  SecondaryHeatExchanger->id = g_ids.intern("Secondary Heat Exchanger");
 
-  PrimaryHeatExchanger->other = SecondaryHeatExchanger;
+  connectThermal(g_primary, *PrimaryHeatExchanger->section, *SecondaryHeatExchanger->section, 0.4);
 
-  buildSecondaryCircuit(SecondaryHeatExchanger);
+  buildSecondaryCircuit(g_secondary, SecondaryHeatExchanger);
 
-  for(auto& s : g_circuit.sections)
+  for(auto& s : g_secondary.sections)
     s.mass *= 4; // augment the amount of water in the secondary circuit
 
-  buildPrimaryCircuit(PrimaryHeatExchanger);
+  PrimaryHeatExchanger->section->mass *= 4; // and in the primary heat exchanger
+
+  buildPrimaryCircuit(g_primary, PrimaryHeatExchanger);
+
+  // other units, if any, are copies of the first one,
+  // laid out on a square grid, with varied pump settings
+  if(units > 1)
+  {
+    auto const unit = capturePrefab(unitStart);
+    g_entities.reserve(units * g_entities.size());
+    g_ids.reserve(units * g_ids.size());
+
+    // once for all the copies: each type gets one more block
+    auto reserveCopies = [&] (auto& captured, auto& pool)
+      {
+        if(!captured.entities.empty())
+          pool.reserve((units - 1) * (int)captured.entities.size());
+      };
+
+    std::apply([&] (auto& ... captured)
+      {
+        std::apply([&] (auto& ... pools) { (reserveCopies(captured, pools), ...); }, g_pools);
+      }, unit.entities);
+
+    auto const columns = (int)ceil(sqrt(units));
+    unsigned n = 0;
+
+    for(int i = 1; i < units; ++i)
+    {
+      auto const offset = Vec2f(UNIT_SIZE * (i % columns), UNIT_SIZE * (i / columns));
+      char prefix[32];
+      snprintf(prefix, sizeof prefix, "[Unit %d] ", i + 1);
+      auto const instance = instantiatePrefab(unit, offset, prefix);
+
+      // +/- 20%
+      for(auto& pump : std::get<View<EPump>>(instance))
+        pump.powerRatio *= 0.8f + 0.4f * randomFloat(seed, n++);
+    }
+  }
+
+  g_actorOfId.assign(g_ids.size(), -1);
+
+  for(int i = 0; i < (int)g_entities.size(); ++i)
+  {
+    if(g_entities[i]->id >= 0)
+      g_actorOfId[g_entities[i]->id] = i;
+  }
+
+  // forward the initial settings to the simulation
+  for(auto& entity : g_entities)
+    entity->onPropertyChanged();
+
+  buildTickGraph();
+
+  // drop commands aimed at the previous game
+  Command cmd;
+
+  while(g_commands.pop(cmd))
+  {
+  }
+
+  g_commandLog.clear();
+
+  publish();
 }
 
 void GameTick()
 {
-  simulate(g_circuit);
-
-  for(auto& entity : g_entities)
-    entity->tick();
+  applyCommands();
+  ++g_tick;
+  scheduler().run(g_tickGraph);
 }
 
 const char* IsGameFinished()
@@ -646,3 +1245,64 @@ const char* IsGameFinished()
   return g_finishMessage;
 }
 
+const GameState& GameGetState()
+{
+  g_published.update();
+  return g_published.front();
+}
+
+bool GameSetProperty(int actor, int property, float value)
+{
+  Command cmd;
+  cmd.kind = Command::SetFloat;
+  cmd.actor = actor;
+  cmd.property = property;
+  cmd.floatValue = value;
+  return g_commands.push(cmd);
+}
+
+bool GameSetProperty(int actor, int property, bool value)
+{
+  Command cmd;
+  cmd.kind = Command::SetBool;
+  cmd.actor = actor;
+  cmd.property = property;
+  cmd.boolValue = value;
+  return g_commands.push(cmd);
+}
+
+void GameSetVisibleArea(Vec2f min, Vec2f max, int selection)
+{
+  auto& area = g_visibleArea.back();
+  area.game = g_published.front().game;
+  area.min = min;
+  area.max = max;
+  area.selection = selection;
+  g_visibleArea.publish();
+}
+
+View<const Command> GameGetCommandLog()
+{
+  return { g_commandLog.data(), g_commandLog.data() + g_commandLog.size() };
+}
+
+const char* GameGetIdName(int id)
+{
+  return id >= 0 ? g_ids.get(id) : "";
+}
+
+int GameFindId(const char* name)
+{
+  return g_ids.find(name);
+}
+
+View<const int> GameFindIds(const char* prefix)
+{
+  std::lock_guard<std::mutex> lock(g_idQueryMutex);
+  return g_ids.withPrefix(prefix);
+}
+
+int GameGetActorIndex(int id)
+{
+  return id >= 0 && id < (int)g_actorOfId.size() ? g_actorOfId[id] : -1;
+}
@@ -6,6 +6,8 @@
 #include <string>
 #include <memory>
 #include "maths.h" // Vec2f
+#include "staticvector.h"
+#include "view.h"
 
 enum class Type
 {
@@ -13,12 +15,45 @@ enum class Type
   Float,
 };
 
+struct Actor;
+
+// Static description of a property, shared by all actors of a type
 struct Property
 {
+  // the value, as a member of Actor: the one matching 'type'
+  union Member
+  {
+    constexpr Member(float Actor::* value) : asFloat(value) {}
+    constexpr Member(bool Actor::* value) : asBool(value) {}
+
+    float Actor::* asFloat;
+    bool Actor::* asBool;
+  };
+
   const char* name;
   Type type;
-  void* pointer;
+  Member member;
   bool readOnly = false;
+  const char* unit = "";
+  float min = 0;
+  float max = 1;
+};
+
+struct PropertyTable
+{
+  PropertyTable() = default;
+
+  template<int N>
+  constexpr PropertyTable(const Property (&table)[N]) : first(table), count(N) {}
+
+  int size() const { return count; }
+  const Property* begin() const { return first; }
+  const Property* end() const { return first + count; }
+  const Property& operator [] (int i) const { return first[i]; }
+
+private:
+  const Property* first = nullptr;
+  int count = 0;
 };
 
 struct Section;
@@ -31,24 +66,114 @@ struct Actor
     float angle = 0;
   };
 
-  virtual ~Actor() = default;
+  static constexpr int MAX_SPRITES = 4;
+  static constexpr int MAX_PROPERTIES = 8;
+  using Sprites = StaticVector<Sprite, MAX_SPRITES>;
 
+  // actors are freed without being destroyed: no destructor here
   Vec2f pos {};
   float angle = 0;
-  std::string id;
+  int id = -1; // handle in the id table, see GameGetIdName()
   virtual float mass() = 0;
   virtual float temperature() = 0;
   virtual float pressure() = 0;
   virtual float flux0() = 0;
   virtual bool selectable() const { return true; }
   virtual Vec2f size() const { return Vec2f(1, 1); }
-  virtual std::vector<Sprite> sprite() const = 0;
+  virtual Sprites sprite() const = 0;
   virtual const char* name() const = 0;
-  virtual std::vector<Property> introspect() const { return {}; };
+  virtual PropertyTable introspect() const { return {}; };
+
+  // called after one of the introspected properties was modified
+  virtual void onPropertyChanged() {}
 };
 
-extern std::vector<Actor*> GameGetActors();
+// Read-only view of an actor, as published by the simulation
+struct ActorState
+{
+  // only the static data (pos, angle, id, size...) can be read from here
+  const Actor* actor = nullptr;
+
+  float mass = 0;
+  float temperature = 0;
+  float pressure = 0;
+  float flux0 = 0;
+
+  Actor::Sprites sprites;
+
+  // introspect(), with the values (bools as 0 or 1)
+  struct PropertyValue
+  {
+    const Property* info;
+    float value;
+  };
+
+  int propertyCount = 0;
+  PropertyValue properties[Actor::MAX_PROPERTIES] {};
+};
+
+struct GameState
+{
+  int game = 0; // changes with each GameInit()
+  int tick = 0; // number of ticks simulated
+  const char* finishMessage = nullptr;
+  std::vector<ActorState> actors; // in the order of GameGetActors()
+};
+
+// Operator command, applied by the simulation at a tick boundary.
+struct Command
+{
+  enum Kind { SetFloat, SetBool };
+
+  Kind kind;
+  int tick; // set by the simulation: applied right after this tick
+  int actor; // index in GameGetActors()
+  int property; // index in Actor::introspect()
+
+  union
+  {
+    float floatValue;
+    bool boolValue;
+  };
+};
+
+// The actors themselves are only modified by GameInit(): from another
+// thread, they must be read from GameGetState(), and modified by GameSetProperty().
+extern View<Actor* const> GameGetActors(); // invalidated by GameInit()
 extern void GameInit();
+
+// Builds 'units' reactor units on a grid instead of one.
+// The same seed always gives the same plant.
+extern void GameInitPlant(int units, unsigned seed);
 extern void GameTick();
 extern const char* IsGameFinished();
 
+// Entity ids are interned, Actor::id being a handle.
+// The id table is only modified by GameInit().
+extern const char* GameGetIdName(int id); // "" for -1
+extern int GameFindId(const char* name); // -1 if none
+extern View<const int> GameFindIds(const char* prefix); // sorted by name, on first use
+extern int GameGetActorIndex(int id); // in GameGetActors(), -1 if none
+
+// Latest state published by GameTick(). Never blocks the simulation,
+// but must only be called from one thread.
+// Invalidated by GameInit().
+extern const GameState& GameGetState();
+
+// Queues a property modification, applied at the start of the next tick.
+// Must be called from the thread calling GameGetState().
+// Returns false if too many commands are already pending.
+extern bool GameSetProperty(int actor, int property, float value);
+extern bool GameSetProperty(int actor, int property, bool value);
+
+// Part of the plant being looked at, in plant coordinates. From the next
+// tick on, only the actors overlapping it, and the selected actor, get
+// their readings and sprites published: the others keep stale values.
+// Until the first call after GameInit(), everything is published.
+// Must be called from the thread calling GameGetState().
+extern void GameSetVisibleArea(Vec2f min, Vec2f max, int selection);
+
+// Commands applied since GameInit(), in order, for recording a game.
+// Must be called from the thread calling GameTick().
+extern View<const Command> GameGetCommandLog();
+
@@ -167,6 +167,9 @@ int main(int, char**)
     SDL_GL_SwapWindow(window);
   }
 
+  extern void AppShutdown();
+  AppShutdown();
+
   // Cleanup
   ImGui_ImplOpenGL3_Shutdown();
   ImGui_ImplSDL2_Shutdown();
@@ -0,0 +1,74 @@
+// Arena of objects of one type.
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+#include "view.h"
+
+// Objects are constructed in place, in blocks, and never move.
+// They are freed all at once, without being destroyed.
+template<typename T>
+struct Pool
+{
+  static_assert(std::is_trivially_destructible<T>::value, "objects are never destroyed");
+
+  using value_type = T;
+
+  static constexpr int BLOCK_SIZE = 1024;
+
+  // constructs 'count' contiguous objects
+  View<T> allocate(int count)
+  {
+    auto r = take(count);
+
+    for(auto& object : r)
+      new(&object)T();
+
+    return r;
+  }
+
+  // copy-constructs 'count' contiguous objects from 'source'
+  View<T> allocate(const T* source, int count)
+  {
+    auto r = take(count);
+
+    for(int i = 0; i < count; ++i)
+      new(&r[i])T(source[i]);
+
+    return r;
+  }
+
+  // Makes room for 'count' more objects in the current block, so the
+  // next allocations, up to 'count' objects, are contiguous.
+  void reserve(int count)
+  {
+    if(blocks.empty() || blocks.back().size() + count > capacity)
+    {
+      capacity = std::max(count, BLOCK_SIZE);
+      storage.emplace_back(new Slot[capacity]);
+      auto first = (T*)storage.back().get();
+      blocks.push_back({ first, first });
+    }
+  }
+
+  // all the objects, block by block
+  std::vector<View<T>> blocks;
+
+private:
+  View<T> take(int count)
+  {
+    reserve(count);
+
+    auto& block = blocks.back();
+    T* first = block.end();
+    block = { block.begin(), first + count };
+    return { first, first + count };
+  }
+
+  using Slot = typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+  std::vector<std::unique_ptr<Slot[]>> storage;
+  int capacity = 0; // of the last block
+};
@@ -0,0 +1,28 @@
+// Counter-based random numbers.
+#pragma once
+
+#include <stdint.h>
+
+// Pure functions of their inputs: each key gets its own stream,
+// which can be drawn in any order, from any thread, and is the same
+// on every platform.
+
+// splitmix64 finalizer
+inline uint64_t mix(uint64_t z)
+{
+  z = (z + 0x9E3779B97F4A7C15ull);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+  return z ^ (z >> 31);
+}
+
+inline uint32_t randomKey(uint32_t a, uint32_t b)
+{
+  return uint32_t(mix(uint64_t(a) << 32 | b) >> 32);
+}
+
+// uniform in [0;1[
+inline float randomFloat(uint32_t key, uint32_t counter)
+{
+  return (mix(uint64_t(key) << 32 | counter) >> 40) * (1.0f / (1 << 24));
+}
@@ -0,0 +1,45 @@
+// Lock-free queue, from one producer thread to one consumer thread.
+#pragma once
+
+#include <atomic>
+
+// Fixed capacity: push() fails when the queue is full, it never waits
+// nor allocates. 'N' must be a power of two.
+template<typename T, int N>
+struct RingBuffer
+{
+  static_assert((N & (N - 1)) == 0, "N must be a power of two");
+
+  // producer side
+  bool push(const T& value)
+  {
+    auto w = writePos.load(std::memory_order_relaxed);
+
+    if(w - readPos.load(std::memory_order_acquire) == N)
+      return false;
+
+    items[w % N] = value;
+    writePos.store(w + 1, std::memory_order_release);
+    return true;
+  }
+
+  // consumer side
+  bool pop(T& value)
+  {
+    auto r = readPos.load(std::memory_order_relaxed);
+
+    if(r == writePos.load(std::memory_order_acquire))
+      return false;
+
+    value = items[r % N];
+    readPos.store(r + 1, std::memory_order_release);
+    return true;
+  }
+
+private:
+  T items[N] {};
+
+  // free-running counters, kept on separate cache lines
+  alignas(64) std::atomic<unsigned> writePos { 0 };
+  alignas(64) std::atomic<unsigned> readPos { 0 };
+};
@@ -0,0 +1,174 @@
+#include "scheduler.h"
+#include <algorithm>
+#include <assert.h>
+
+TaskGraph::Task TaskGraph::add(std::function<void()> work, std::vector<Task> dependencies)
+{
+  const Task task = (Task)nodes.size();
+  nodes.push_back({});
+  nodes.back().work = std::move(work);
+  nodes.back().dependencyCount = (int)dependencies.size();
+
+  for(auto dependency : dependencies)
+  {
+    assert(dependency < task);
+    nodes[dependency].successors.push_back(task);
+  }
+
+  return task;
+}
+
+Scheduler::Scheduler(int threadCount)
+{
+  threadCount = std::max(0, threadCount);
+
+  for(int i = 0; i < threadCount + 1; ++i)
+    queues.push_back(std::make_unique<Queue>());
+
+  for(int i = 1; i <= threadCount; ++i)
+    threads.emplace_back(&Scheduler::workerMain, this, i);
+}
+
+Scheduler::~Scheduler()
+{
+  {
+    std::lock_guard<std::mutex> lock(sleepMutex);
+    quit = true;
+  }
+
+  wake.notify_all();
+
+  for(auto& thread : threads)
+    thread.join();
+}
+
+void Scheduler::run(TaskGraph& graph)
+{
+  const int N = (int)graph.nodes.size();
+
+  if(N == 0)
+    return;
+
+  if(remainingSize < N)
+  {
+    remaining.reset(new std::atomic<int>[N]);
+    remainingSize = N;
+  }
+
+  for(int i = 0; i < N; ++i)
+    remaining[i] = graph.nodes[i].dependencyCount;
+
+  current = &graph;
+  unfinished = N;
+
+  for(int i = 0; i < N; ++i)
+  {
+    if(graph.nodes[i].dependencyCount == 0)
+      push(0, i);
+  }
+
+  notify();
+
+  while(unfinished > 0)
+  {
+    if(runOne(0))
+      continue;
+
+    std::unique_lock<std::mutex> lock(sleepMutex);
+    wake.wait(lock, [&] () { return unfinished == 0 || queued > 0; });
+  }
+
+  current = nullptr;
+}
+
+void Scheduler::workerMain(int index)
+{
+  while(true)
+  {
+    if(runOne(index))
+      continue;
+
+    std::unique_lock<std::mutex> lock(sleepMutex);
+    wake.wait(lock, [&] () { return quit || queued > 0; });
+
+    if(quit)
+      return;
+  }
+}
+
+bool Scheduler::runOne(int index)
+{
+  TaskGraph::Task task = -1;
+
+  // own queue first, most recent task (likely hot in cache)
+  {
+    auto& queue = *queues[index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+
+    if(!queue.tasks.empty())
+    {
+      task = queue.tasks.back();
+      queue.tasks.pop_back();
+      --queued;
+    }
+  }
+
+  // then steal the oldest task of another thread
+  for(int i = 1; task < 0 && i < (int)queues.size(); ++i)
+  {
+    auto& queue = *queues[(index + i) % queues.size()];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+
+    if(!queue.tasks.empty())
+    {
+      task = queue.tasks.front();
+      queue.tasks.pop_front();
+      --queued;
+    }
+  }
+
+  if(task < 0)
+    return false;
+
+  auto& node = current->nodes[task];
+  node.work();
+
+  int ready = 0;
+
+  for(auto successor : node.successors)
+  {
+    if(--remaining[successor] == 0)
+    {
+      push(index, successor);
+      ++ready;
+    }
+  }
+
+  // keep one ready task for ourselves, share the others
+  if(ready > 1)
+    notify();
+
+  if(--unfinished == 0)
+    notify();
+
+  return true;
+}
+
+void Scheduler::push(int index, TaskGraph::Task task)
+{
+  auto& queue = *queues[index];
+  std::lock_guard<std::mutex> lock(queue.mutex);
+  queue.tasks.push_back(task);
+  ++queued;
+}
+
+void Scheduler::notify()
+{
+  // taking the lock guarantees sleepers either see the new state,
+  // or are already waiting and get the notification.
+  {
+    std::lock_guard<std::mutex> lock(sleepMutex);
+  }
+
+  wake.notify_all();
+}
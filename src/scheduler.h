@@ -0,0 +1,65 @@
+// Small work-stealing task scheduler.
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A set of tasks with dependencies, run to completion by Scheduler::run().
+// Can be run several times.
+struct TaskGraph
+{
+  using Task = int;
+
+  Task add(std::function<void()> work, std::vector<Task> dependencies = {});
+
+  struct Node
+  {
+    std::function<void()> work;
+    std::vector<Task> successors;
+    int dependencyCount = 0;
+  };
+
+  std::vector<Node> nodes;
+};
+
+// Each thread has its own queue of ready tasks: it pushes and pops at the
+// back, and when empty, steals from the front of the other queues.
+struct Scheduler
+{
+  explicit Scheduler(int threadCount = (int)std::thread::hardware_concurrency() - 1);
+  ~Scheduler();
+
+  // Runs all the tasks of the graph, the calling thread taking part.
+  void run(TaskGraph& graph);
+
+private:
+  struct Queue
+  {
+    std::mutex mutex;
+    std::deque<TaskGraph::Task> tasks;
+  };
+
+  void workerMain(int index);
+  bool runOne(int index);
+  void push(int index, TaskGraph::Task task);
+  void notify();
+
+  std::vector<std::unique_ptr<Queue>> queues; // 0: the thread calling run()
+  std::vector<std::thread> threads;
+
+  std::mutex sleepMutex;
+  std::condition_variable wake;
+  std::atomic<int> queued { 0 };
+  std::atomic<int> unfinished { 0 };
+  bool quit = false;
+
+  TaskGraph* current = nullptr; // graph being run
+  std::unique_ptr<std::atomic<int>[]> remaining; // per task: dependencies left
+  int remainingSize = 0;
+};
@@ -0,0 +1,44 @@
+#include "sensors.h"
+#include "simuflow.h"
+#include <assert.h>
+
+SensorBank::SensorBank(int period) : mask(period - 1)
+{
+  assert(period > 0 && (period & (period - 1)) == 0);
+}
+
+int SensorBank::add(const Section& source, Quantity quantity, float* output, float alpha)
+{
+  sources.push_back(&source);
+  quantities.push_back(quantity);
+  alphas.push_back(alpha);
+  values.push_back(0);
+  outputs.push_back(output);
+  inputs.push_back(0);
+  return size() - 1;
+}
+
+void SensorBank::clear()
+{
+  *this = SensorBank(mask + 1);
+}
+
+void SensorBank::update(int tick, int begin, int end)
+{
+  if(tick & mask)
+    return;
+
+  // gather, the only pass touching the sections
+  for(int i = begin; i < end; ++i)
+  {
+    auto& s = *sources[i];
+    auto const q = quantities[i];
+    inputs[i] = q == Quantity::Temperature ? s.T : q == Quantity::Pressure ? s.pressure() : s.flux0;
+  }
+
+  for(int i = begin; i < end; ++i)
+    values[i] += alphas[i] * (inputs[i] - values[i]);
+
+  for(int i = begin; i < end; ++i)
+    *outputs[i] = values[i];
+}
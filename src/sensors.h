@@ -0,0 +1,44 @@
+// Instruments reading sections, with a first order low-pass filter.
+// All the sensors are stored as arrays, and updated in bulk.
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+struct Section;
+
+enum class Quantity : uint8_t
+{
+  Temperature,
+  Pressure,
+  Flux,
+};
+
+// All the sensors of a bank are sampled together, every 'period' ticks:
+// sensors needing different periods go to different banks.
+struct SensorBank
+{
+  // 'period' is a power of two
+  explicit SensorBank(int period = 1);
+
+  // 'alpha' is the filter coefficient, 1 for no filtering.
+  // The filtered reading is written to 'output' on every sample.
+  int add(const Section& source, Quantity quantity, float* output, float alpha = 1);
+
+  int size() const { return (int)sources.size(); }
+
+  void clear();
+
+  // Samples sensors [begin;end[, if 'tick' is a sampling tick.
+  // Disjoint ranges can be updated concurrently.
+  void update(int tick, int begin, int end);
+
+private:
+  int mask; // period - 1
+  std::vector<const Section*> sources;
+  std::vector<Quantity> quantities;
+  std::vector<float> alphas;
+  std::vector<float> values; // filter state
+  std::vector<float*> outputs;
+  std::vector<float> inputs; // scratch
+};
@@ -1,5 +1,9 @@
 #include "simuflow.h"
 #include <assert.h>
+#include <math.h>
+#include <algorithm>
+#include <map>
+#include <tuple>
 
 void connectSections(Circuit& circuit, Section& a, Section& b)
 {
@@ -7,62 +11,834 @@ void connectSections(Circuit& circuit, Section& a, Section& b)
     { &a, &b }, 0.0f });
 }
 
-void simulate(Circuit& circuit)
+void connectThermal(Circuit& circuit, Section& a, Section& b, float conductance)
 {
-  const float dt = 1.0;
+  circuit.thermalLinks.push_back(ThermalLink{
+    { &a, &b }, conductance });
+}
 
-  // compute section pressures
-  for(auto& s : circuit.sections)
+namespace
+{
+// the heap isn't stable: same-tick events are ordered by sequence
+bool later(const ActuatorEvent& a, const ActuatorEvent& b)
+{
+  if(a.tick != b.tick)
+    return a.tick > b.tick;
+
+  return a.sequence > b.sequence;
+}
+}
+
+void schedule(Circuit& circuit, ActuatorEvent event)
+{
+  event.sequence = circuit.scheduledCount++;
+  circuit.events.push_back(event);
+  std::push_heap(circuit.events.begin(), circuit.events.end(), later);
+}
+
+void sortConnections(Circuit& circuit)
+{
+  auto bySource = [] (const Connection& a, const Connection& b)
+    {
+      return a.sections[0] < b.sections[0];
+    };
+  std::stable_sort(circuit.connections.begin(), circuit.connections.end(), bySource);
+
+  // derived from the connection order
+  circuit.adjacency.connectionCount = -1;
+  circuit.chainedConnectionCount = -1;
+}
+
+namespace
+{
+void removeRamp(Circuit& circuit, float* target)
+{
+  auto& ramps = circuit.ramps;
+  auto i = circuit.rampOf.find(target);
+
+  if(i == circuit.rampOf.end())
+    return;
+
+  auto const index = i->second;
+  circuit.rampOf.erase(i);
+
+  if(index != (int)ramps.size() - 1)
   {
-    assert(s.mass >= 0);
-    s.P = (s.mass * 0.003 * s.T) / s.V;
+    ramps[index] = ramps.back();
+    circuit.rampOf[ramps[index].target] = index;
   }
 
-  // update flux
-  for(auto& conn : circuit.connections)
+  ramps.pop_back();
+}
+
+void applyEvents(Circuit& circuit, int tick)
+{
+  auto& events = circuit.events;
+  auto& ramps = circuit.ramps;
+
+  while(!events.empty() && events.front().tick <= tick)
+  {
+    std::pop_heap(events.begin(), events.end(), later);
+    const auto event = events.back();
+    events.pop_back();
+
+    removeRamp(circuit, event.target);
+
+    if(event.duration > 0)
+    {
+      circuit.rampOf[event.target] = ramps.size();
+      ramps.push_back(Ramp{ event.target, *event.target, event.value, tick, tick + event.duration });
+    }
+    else
+      *event.target = event.value;
+  }
+
+  for(int i = 0; i < (int)ramps.size(); ++i)
+  {
+    auto& ramp = ramps[i];
+
+    if(tick >= ramp.end)
+    {
+      *ramp.target = ramp.to;
+      removeRamp(circuit, ramp.target);
+      --i;
+      continue;
+    }
+
+    const float progress = float(tick - ramp.begin) / (ramp.end - ramp.begin);
+    *ramp.target = ramp.from + (ramp.to - ramp.from) * progress;
+  }
+}
+
+// 'ends(c, i0, i1)' gives the indices of the sections at both ends of connection c
+template<typename Ends>
+void buildAdjacency(Adjacency& adj, int N, int C, Ends ends)
+{
+  if(adj.connectionCount == C && (int)adj.first.size() == N + 1)
+    return;
+
+  // count neighbours, then fill each row
+  adj.first.assign(N + 1, 0);
+
+  for(int c = 0; c < C; ++c)
+  {
+    int i0, i1;
+    ends(c, i0, i1);
+    adj.first[i0 + 1]++;
+    adj.first[i1 + 1]++;
+  }
+
+  for(int i = 0; i < N; ++i)
+    adj.first[i + 1] += adj.first[i];
+
+  adj.neighbours.resize(adj.first[N]);
+  adj.edges.resize(adj.first[N]);
+  Array<int> fill(adj.first.begin(), adj.first.end() - 1);
+
+  for(int c = 0; c < C; ++c)
+  {
+    int i0, i1;
+    ends(c, i0, i1);
+    adj.edges[fill[i0]] = c;
+    adj.neighbours[fill[i0]++] = i1;
+    adj.edges[fill[i1]] = c;
+    adj.neighbours[fill[i1]++] = i0;
+  }
+
+  adj.connectionCount = C;
+}
+
+void updateAdjacency(Circuit& circuit)
+{
+  auto* base = circuit.sections.data();
+  auto ends = [&] (int c, int& i0, int& i1)
+    {
+      i0 = int(circuit.connections[c].sections[0] - base);
+      i1 = int(circuit.connections[c].sections[1] - base);
+    };
+  buildAdjacency(circuit.adjacency, (int)circuit.sections.size(), (int)circuit.connections.size(), ends);
+}
+
+// y = A.x, where A is the adjacency matrix
+void multiply(const Adjacency& adj, const double* x, double* y)
+{
+  const int N = (int)adj.first.size() - 1;
+
+  for(int i = 0; i < N; ++i)
+  {
+    double sum = 0;
+
+    for(int k = adj.first[i]; k < adj.first[i + 1]; ++k)
+      sum += x[adj.neighbours[k]];
+
+    y[i] = sum;
+  }
+}
+
+// y = (I + k.L).x, where L is the graph laplacian
+void multiplyConduction(const Adjacency& adj, double k, const double* x, double* y)
+{
+  const int N = (int)adj.first.size() - 1;
+  multiply(adj, x, y);
+
+  for(int i = 0; i < N; ++i)
+  {
+    const int degree = adj.first[i + 1] - adj.first[i];
+    y[i] = x[i] + k * (degree * x[i] - y[i]);
+  }
+}
+
+double dot(const double* a, const double* b, int N)
+{
+  double sum = 0;
+
+  for(int i = 0; i < N; ++i)
+    sum += a[i] * b[i];
+
+  return sum;
+}
+
+void conductHeat(Circuit& circuit, float dt)
+{
+  updateAdjacency(circuit);
+
+  auto& adj = circuit.adjacency;
+  const int N = (int)circuit.sections.size();
+  const double k = circuit.wallConductance * dt;
+
+  // in double precision: with a large k, (I + k.L) has large terms that
+  // cancel out, and float rounding would create or destroy heat
+
+  // [0, N): temperatures at the start of the step
+  // [N, 2N): current estimate
+  // [2N, 5N): sum of the neighbour temperatures (explicit),
+  //           or residual, direction and product (implicit)
+  circuit.scratch.resize(5 * N);
+  double* T0 = circuit.scratch.data();
+  double* T = T0 + N;
+  double* sum = T + N;
+
+  for(int i = 0; i < N; ++i)
+    T0[i] = T[i] = circuit.sections[i].T;
+
+  if(circuit.implicitConduction)
+  {
+    // Conjugate gradients on (I + k.L).T = T0: the matrix is symmetric
+    // positive definite. The columns of L sum to 0, so every estimate
+    // holds the same amount of heat as T0, whenever the iterations stop.
+    double* r = sum;
+    double* p = r + N;
+    double* Ap = p + N;
+
+    multiplyConduction(adj, k, T, Ap);
+
+    for(int i = 0; i < N; ++i)
+      p[i] = r[i] = T0[i] - Ap[i];
+
+    // until the residual is 1e-5 of T0 (relative), and at most N iterations,
+    // after which the estimate is exact, rounding errors aside
+    double rr = dot(r, r, N);
+    const double tolerance = 1e-10 * dot(T0, T0, N);
+
+    for(int iteration = 0; iteration < N && rr > tolerance; ++iteration)
+    {
+      multiplyConduction(adj, k, p, Ap);
+      const double alpha = rr / dot(p, Ap, N);
+
+      for(int i = 0; i < N; ++i)
+      {
+        T[i] += alpha * p[i];
+        r[i] -= alpha * Ap[i];
+      }
+
+      const double previous = rr;
+      rr = dot(r, r, N);
+
+      for(int i = 0; i < N; ++i)
+        p[i] = r[i] + rr / previous * p[i];
+    }
+  }
+  else
+  {
+    multiply(adj, T0, sum);
+
+    for(int i = 0; i < N; ++i)
+    {
+      const int degree = adj.first[i + 1] - adj.first[i];
+      T[i] = T0[i] + k * (sum[i] - degree * T0[i]);
+    }
+  }
+
+  for(int i = 0; i < N; ++i)
+    circuit.sections[i].T = T[i];
+}
+
+void accelerate(Connection& conn, float P0, float P1, float dt)
+{
+  auto& s0 = *conn.sections[0];
+  conn.flux += (P0 - P1 + s0.selfFlux) * 0.1 * dt;
+  conn.flux *= dt == 1 ? s0.damping : powf(s0.damping, dt);
+}
+
+void transfer(Connection& conn, float dt)
+{
+  auto* s0 = conn.sections[0];
+  auto* s1 = conn.sections[1];
+  auto dMass = conn.flux * dt;
+  const auto sign = conn.flux > 0 ? 1.0f : -1.0f;
+
+  if(dMass < 0)
+  {
+    dMass = -dMass;
+    std::swap(s0, s1);
+  }
+
+  // at this point,
+  // we're transfering fluid from s0 to s1
+  assert(dMass == dMass);
+  assert(dMass >= 0);
+  assert(s0->mass >= 0);
+
+  // don't transfer more fluid than available in s0
+  dMass = std::min(dMass, s0->mass);
+
+  // update s1 temperature
+  if(dMass > 0)
+    s1->T = (s1->T * s1->mass + s0->T * dMass) / (s1->mass + dMass);
+
+  assert(s1->T == s1->T);
+  assert(s1->T >= 0);
+
+  s0->mass -= dMass;
+  s1->mass += dMass;
+
+  conn.flux = sign * (dMass / dt);
+
+  // update flux0 for monitoring
+  conn.sections[0]->flux0 = conn.flux;
+}
+
+// heat sources and sinks
+void heat(const Circuit& circuit, Section& s, float dt)
+{
+  s.T += s.heating * dt;
+  s.T += (circuit.ambientT - s.T) * std::min(1.0f, s.cooling * dt);
+}
+
+// true if connection i goes from section i to section i + 1,
+// the last one possibly closing a ring on section 0.
+bool isChained(Circuit& circuit)
+{
+  const int C = (int)circuit.connections.size();
+
+  if(circuit.chainedConnectionCount == C)
+    return circuit.chained;
+
+  auto* sections = circuit.sections.data();
+  circuit.chained = true;
+
+  for(int i = 0; i < C; ++i)
   {
-    auto& s0 = *conn.sections[0];
-    auto& s1 = *conn.sections[1];
-    conn.flux += (s0.P - s1.P + s0.selfFlux) * 0.1 * dt;
-    conn.flux *= s0.damping;
+    auto& conn = circuit.connections[i];
+    const bool closing = i == C - 1 && conn.sections[1] == &sections[0];
+
+    if(conn.sections[0] != &sections[i] || (conn.sections[1] != &sections[i + 1] && !closing))
+    {
+      circuit.chained = false;
+      break;
+    }
   }
 
+  circuit.chainedConnectionCount = C;
+  return circuit.chained;
+}
+
+// Single pass version of step(), for chained circuits without conduction.
+// A section's pressure is needed by at most two consecutive connections,
+// so it's computed on the fly, and a section gets its heat terms as soon
+// as the last connection touching it has been processed.
+void stepChain(Circuit& circuit, float dt)
+{
+  auto& sections = circuit.sections;
+  auto& connections = circuit.connections;
+  const int N = (int)sections.size();
+  const int C = (int)connections.size();
+
+  if(N == 0)
+    return;
+
+  const bool ring = C > 1 && connections.back().sections[1] == &sections[0];
+  const float firstP = sections[0].pressure();
+  float P = firstP;
+
+  for(int i = 0; i < C; ++i)
+  {
+    auto& conn = connections[i];
+    const float nextP = ring && i == C - 1 ? firstP : conn.sections[1]->pressure();
+
+    accelerate(conn, P, nextP, dt);
+    transfer(conn, dt);
+
+    if(i > 0 || !ring)
+      heat(circuit, sections[i], dt);
+
+    P = nextP;
+  }
+
+  if(ring)
+    heat(circuit, sections[0], dt);
+
+  // end of the chain, and sections not connected at all
+  for(int i = C; i < N; ++i)
+    heat(circuit, sections[i], dt);
+}
+
+void step(Circuit& circuit, float dt)
+{
+  if(circuit.wallConductance == 0 && isChained(circuit))
+  {
+    stepChain(circuit, dt);
+    return;
+  }
+
+  // update flux. Pressures are recomputed rather than stored:
+  // the section data is loaded anyway.
+  for(auto& conn : circuit.connections)
+    accelerate(conn, conn.sections[0]->pressure(), conn.sections[1]->pressure(), dt);
+
   // apply flux: update N
   for(auto& conn : circuit.connections)
+    transfer(conn, dt);
+
+  if(circuit.wallConductance > 0)
+    conductHeat(circuit, dt);
+
+  for(auto& s : circuit.sections)
+    heat(circuit, s, dt);
+}
+
+void applyThermalLinks(Circuit& circuit, float dt)
+{
+  for(auto& link : circuit.thermalLinks)
+  {
+    auto& s0 = *link.sections[0];
+    auto& s1 = *link.sections[1];
+    const float delta = (s1.T - s0.T) * std::min(0.5f, link.conductance * dt);
+    s0.T += delta;
+    s1.T -= delta;
+  }
+}
+
+// Workspace circuits are small and hot: they stay on the heap,
+// whatever the backing of the circuit they work on.
+void allocateOnHeap(Circuit& circuit)
+{
+  const StorageAllocator<char> heap(Backing::Heap);
+  circuit.sections = Array<Section>(heap);
+  circuit.connections = Array<Connection>(heap);
+  circuit.thermalLinks = Array<ThermalLink>(heap);
+  circuit.events = Array<ActuatorEvent>(heap);
+  circuit.ramps = Array<Ramp>(heap);
+  circuit.adjacency.first = Array<int>(heap);
+  circuit.adjacency.neighbours = Array<int>(heap);
+  circuit.adjacency.edges = Array<int>(heap);
+  circuit.scratch = Array<double>(heap);
+}
+
+// Temporal blocking, over any storage of the sections. 'Store' provides:
+// - load(i): section i, widened to a Section
+// - ends(c, i0, i1) and flux(c): connection c
+// - save(i, section) and saveFlux(c, flux): results, written in place.
+// Each tile is written back as soon as it's done, but the halos of the next
+// tiles must still read the previous state: the sections a later halo can
+// reach, i.e closer than 'halo' to the outside of the tile, are kept aside
+// before being overwritten.
+template<typename Store>
+void simulateTiles(Store& store, const Adjacency& adj, const Circuit& settings, int steps, int tileSize)
+{
+  const int N = (int)adj.first.size() - 1;
+  const int halo = 2 * steps;
+  const float dt = settings.period;
+
+  Circuit tile;
+  allocateOnHeap(tile);
+  tile.ambientT = settings.ambientT;
+  tile.wallConductance = settings.wallConductance;
+  tile.implicitConduction = settings.implicitConduction;
+
+  std::unordered_map<int, Section> previous; // by section, from the tiles already written
+  std::unordered_map<int, float> previousFlux; // by connection
+
+  std::vector<int> members; // tile sections, interior first
+  std::unordered_map<int, int> haloIndex; // index in 'members' of the halo sections
+  std::vector<int> edges; // connections with both ends inside the tile
+  int sortedEdges = 0; // the ones from the interior
+  std::vector<int> boundary; // interior sections reachable from a later halo
+  std::vector<int> distance; // to the outside of the tile, by interior section
+
+  for(int begin = 0; begin < N; begin += tileSize)
   {
-    auto* s0 = conn.sections[0];
-    auto* s1 = conn.sections[1];
-    auto dMass = conn.flux * dt;
-    const auto sign = conn.flux > 0 ? 1.0f : -1.0f;
+    const int end = std::min(N, begin + tileSize);
+
+    auto localIndex = [&] (int i)
+      {
+        if(i >= begin && i < end)
+          return i - begin;
+
+        auto found = haloIndex.find(i);
+        return found == haloIndex.end() ? -1 : found->second;
+      };
+
+    members.clear();
+    haloIndex.clear();
+
+    for(int i = begin; i < end; ++i)
+      members.push_back(i);
+
+    // grow the halo, one layer of neighbours at a time
+    int layerBegin = 0;
+
+    for(int layer = 0; layer < halo; ++layer)
+    {
+      const int layerEnd = (int)members.size();
+
+      for(int m = layerBegin; m < layerEnd; ++m)
+      {
+        const int i = members[m];
+
+        for(int k = adj.first[i]; k < adj.first[i + 1]; ++k)
+        {
+          const int j = adj.neighbours[k];
+
+          if(localIndex(j) >= 0)
+            continue;
+
+          haloIndex[j] = (int)members.size();
+          members.push_back(j);
+        }
+      }
+
+      layerBegin = layerEnd;
+    }
+
+    // keep the original order of the connections:
+    // the transfer pass depends on it.
+    edges.clear();
+
+    for(int m = 0; m < (int)members.size(); ++m)
+    {
+      const int i = members[m];
+
+      // the halo connections usually come in two sorted runs,
+      // merged below: no need to sort the whole tile
+      if(m == end - begin)
+        sortedEdges = (int)edges.size();
+
+      for(int k = adj.first[i]; k < adj.first[i + 1]; ++k)
+      {
+        int i0, i1;
+        store.ends(adj.edges[k], i0, i1);
 
-    if(dMass < 0)
+        if(i0 == i && localIndex(adj.neighbours[k]) >= 0)
+          edges.push_back(adj.edges[k]);
+      }
+    }
+
+    if(members.size() == size_t(end - begin))
+      sortedEdges = (int)edges.size();
+
+    auto const haloEdges = edges.begin() + sortedEdges;
+
+    if(!std::is_sorted(edges.begin(), haloEdges))
+      std::sort(edges.begin(), haloEdges);
+
+    std::sort(haloEdges, edges.end());
+    std::inplace_merge(edges.begin(), haloEdges, edges.end());
+
+    // only the sections before the tile were overwritten
+    tile.sections.clear();
+
+    for(auto i : members)
     {
-      dMass = -dMass;
-      std::swap(s0, s1);
+      auto kept = i < begin ? previous.find(i) : previous.end();
+      tile.sections.push_back(kept != previous.end() ? kept->second : store.load(i));
     }
 
-    // at this point,
-    // we're transfering fluid from s0 to s1
-    assert(dMass == dMass);
-    assert(dMass >= 0);
+    tile.connections.clear();
+
+    for(auto c : edges)
+    {
+      int i0, i1;
+      store.ends(c, i0, i1);
+      auto& s0 = tile.sections[localIndex(i0)];
+      auto& s1 = tile.sections[localIndex(i1)];
+      auto kept = i0 < begin ? previousFlux.find(c) : previousFlux.end();
+      tile.connections.push_back(Connection{ { &s0, &s1 }, kept != previousFlux.end() ? kept->second : store.flux(c) });
+    }
+
+    tile.adjacency.connectionCount = -1;
+    tile.chainedConnectionCount = -1;
+
+    for(int s = 0; s < steps; ++s)
+      step(tile, dt);
+
+    // breadth-first search from the outside of the tile
+    boundary.clear();
+    distance.assign(end - begin, 0);
+
+    for(int i = begin; i < end; ++i)
+    {
+      for(int k = adj.first[i]; k < adj.first[i + 1]; ++k)
+      {
+        const int j = adj.neighbours[k];
+
+        if(j < begin || j >= end)
+        {
+          distance[i - begin] = 1;
+          boundary.push_back(i);
+          break;
+        }
+      }
+    }
+
+    for(int b = 0; b < (int)boundary.size(); ++b)
+    {
+      const int i = boundary[b];
+
+      if(distance[i - begin] == halo)
+        continue;
+
+      for(int k = adj.first[i]; k < adj.first[i + 1]; ++k)
+      {
+        const int j = adj.neighbours[k];
+
+        if(j < begin || j >= end || distance[j - begin])
+          continue;
+
+        distance[j - begin] = distance[i - begin] + 1;
+        boundary.push_back(j);
+      }
+    }
+
+    for(auto i : boundary)
+    {
+      previous[i] = store.load(i);
+
+      for(int k = adj.first[i]; k < adj.first[i + 1]; ++k)
+      {
+        int i0, i1;
+        store.ends(adj.edges[k], i0, i1);
+
+        if(i0 == i)
+          previousFlux[adj.edges[k]] = store.flux(adj.edges[k]);
+      }
+    }
+
+    // only the interior is accurate, the halo is discarded
+    for(int i = begin; i < end; ++i)
+      store.save(i, tile.sections[i - begin]);
+
+    for(int e = 0; e < (int)edges.size(); ++e)
+    {
+      int i0, i1;
+      store.ends(edges[e], i0, i1);
+
+      if(i0 >= begin && i0 < end)
+        store.saveFlux(edges[e], tile.connections[e].flux);
+    }
+  }
+}
+
+struct CircuitStore
+{
+  Circuit& circuit;
+
+  Section load(int i) const { return circuit.sections[i]; }
+  float flux(int c) const { return circuit.connections[c].flux; }
+
+  void ends(int c, int& i0, int& i1) const
+  {
+    i0 = int(circuit.connections[c].sections[0] - circuit.sections.data());
+    i1 = int(circuit.connections[c].sections[1] - circuit.sections.data());
+  }
+
+  void save(int i, const Section& s) { circuit.sections[i] = s; }
+  void saveFlux(int c, float flux) { circuit.connections[c].flux = flux; }
+};
+
+uint16_t quantize(float value, float scale)
+{
+  return (uint16_t)std::min(65535.0f, std::max(0.0f, roundf(value / scale)));
+}
+
+// rounds the mass, and carries the rounding error over
+uint16_t quantizeMass(PackedCircuit& packed, float mass)
+{
+  mass += packed.massCarry;
+  auto const r = quantize(mass, packed.massScale);
+  packed.massCarry = mass - r * packed.massScale;
+  return r;
+}
+
+Section widen(const PackedCircuit& packed, int i)
+{
+  auto& p = packed.sections[i];
+  Section s = packed.types[p.type];
+  s.mass = p.mass * packed.massScale;
+  s.T = p.T * packed.temperatureScale;
+  return s;
+}
+
+struct PackedStore
+{
+  PackedCircuit& packed;
+
+  Section load(int i) const { return widen(packed, i); }
+
+  float flux(int c) const { return packed.connections[c].flux; }
+
+  void ends(int c, int& i0, int& i1) const
+  {
+    i0 = packed.connections[c].sections[0];
+    i1 = packed.connections[c].sections[1];
+  }
+
+  void save(int i, const Section& s)
+  {
+    packed.sections[i].mass = quantizeMass(packed, s.mass);
+    packed.sections[i].T = quantize(s.T, packed.temperatureScale);
+  }
+
+  void saveFlux(int c, float flux) { packed.connections[c].flux = flux; }
+};
+}
+
+void simulate(Circuit& circuit, int tick)
+{
+  advance(circuit, tick);
+  exchangeHeat(circuit, tick);
+}
+
+void advance(Circuit& circuit, int tick)
+{
+  applyEvents(circuit, tick);
+
+  if(tick % circuit.period)
+    return;
+
+  step(circuit, circuit.period);
+}
+
+void exchangeHeat(Circuit& circuit, int tick)
+{
+  if(tick % circuit.period)
+    return;
 
-    // don't transfer more fluid than available in s0
-    dMass = std::min(dMass, s0->mass);
+  applyThermalLinks(circuit, circuit.period);
+}
 
-    // update s1 temperature
-    if(dMass > 0)
-      s1->T = (s1->T * s1->mass + s0->T * dMass) / (s1->mass + dMass);
+void simulateBlocked(Circuit& circuit, int steps, int tileSize)
+{
+  updateAdjacency(circuit);
 
-    assert(s1->T == s1->T);
-    assert(s1->T >= 0);
+  CircuitStore store { circuit };
+  simulateTiles(store, circuit.adjacency, circuit, steps, tileSize);
 
-    s0->mass -= dMass;
-    s1->mass += dMass;
+  applyThermalLinks(circuit, circuit.period * steps);
+}
+
+PackedCircuit pack(const Circuit& circuit)
+{
+  PackedCircuit r;
+  r.period = circuit.period;
+  r.ambientT = circuit.ambientT;
+  r.wallConductance = circuit.wallConductance;
+  r.implicitConduction = circuit.implicitConduction;
 
-    conn.flux = sign * (dMass / dt);
+  // leave room for the values to grow
+  float maxMass = 0;
+  float maxT = 0;
 
-    // update flux0 for monitoring
-    conn.sections[0]->flux0 = conn.flux;
+  for(auto& s : circuit.sections)
+  {
+    maxMass = std::max(maxMass, s.mass);
+    maxT = std::max(maxT, s.T);
   }
+
+  r.massScale = maxMass > 0 ? maxMass * 4 / 65535 : 1;
+  r.temperatureScale = maxT > 0 ? maxT * 4 / 65535 : 1;
+
+  // everything but mass and temperature goes to the type table
+  auto key = [] (const Section& s) { return std::make_tuple(s.selfFlux, s.damping, s.heating, s.cooling, s.V); };
+  std::map<decltype(key(Section())), uint16_t> types;
+
+  r.sections.reserve(circuit.sections.size());
+
+  for(auto& s : circuit.sections)
+  {
+    auto i = types.find(key(s));
+
+    if(i == types.end())
+    {
+      assert(r.types.size() < 65536);
+      i = types.insert({ key(s), (uint16_t)r.types.size() }).first;
+      Section type = s;
+      type.mass = 0;
+      type.T = 0;
+      type.flux0 = 0;
+      r.types.push_back(type);
+    }
+
+    r.sections.push_back(PackedSection{ quantizeMass(r, s.mass), quantize(s.T, r.temperatureScale), i->second });
+  }
+
+  r.connections.reserve(circuit.connections.size());
+
+  for(auto& conn : circuit.connections)
+  {
+    const int i0 = int(conn.sections[0] - circuit.sections.data());
+    const int i1 = int(conn.sections[1] - circuit.sections.data());
+    r.connections.push_back(PackedConnection{ { i0, i1 }, conn.flux });
+  }
+
+  return r;
+}
+
+void unpack(const PackedCircuit& packed, Circuit& circuit)
+{
+  assert(circuit.sections.size() == packed.sections.size());
+  assert(circuit.connections.size() == packed.connections.size());
+
+  for(int i = 0; i < (int)packed.sections.size(); ++i)
+  {
+    auto& s = circuit.sections[i];
+    const auto flux0 = s.flux0;
+    s = widen(packed, i);
+    s.flux0 = flux0;
+  }
+
+  if(!circuit.sections.empty())
+    circuit.sections[0].mass += packed.massCarry;
+
+  for(int c = 0; c < (int)packed.connections.size(); ++c)
+    circuit.connections[c].flux = packed.connections[c].flux;
 }
 
+void simulateBlocked(PackedCircuit& packed, int steps, int tileSize)
+{
+  auto ends = [&] (int c, int& i0, int& i1)
+    {
+      i0 = packed.connections[c].sections[0];
+      i1 = packed.connections[c].sections[1];
+    };
+  buildAdjacency(packed.adjacency, (int)packed.sections.size(), (int)packed.connections.size(), ends);
+
+  Circuit settings;
+  settings.period = packed.period;
+  settings.ambientT = packed.ambientT;
+  settings.wallConductance = packed.wallConductance;
+  settings.implicitConduction = packed.implicitConduction;
+
+  PackedStore store { packed };
+  simulateTiles(store, packed.adjacency, settings, steps, tileSize);
+}
@@ -1,7 +1,10 @@
 // Simulation of fluid flowing inside pipes.
 #pragma once
 
+#include <stdint.h>
+#include <unordered_map>
 #include <vector>
+#include "storage.h"
 
 // A constant-volume section of the pipeline,
 // potentially connected to other sections.
@@ -12,6 +15,8 @@ struct Section
   // user-updated quantities
   float selfFlux = 0; // set to non-zero for pumps
   float damping = 0.99; // set to less 0 for valves
+  float heating = 0; // temperature increase per unit of time (e.g reactor core)
+  float cooling = 0; // rate of relaxation towards ambient temperature (e.g cooling tower)
 
   // simulator-updated quantities
   float mass = 0.0; // mass of fluid inside the section
@@ -19,10 +24,12 @@ struct Section
 
   // non-persistent quantities (=recomputed each frame)
   float flux0; // flux of the first connection
-  float P; // pressure
 
   // constant quantities
   float V = 1.0; // volume (constant because sections are rigid)
+
+  // not stored: the solver recomputes it when needed
+  float pressure() const { return (mass * 0.003 * T) / V; }
 };
 
 struct Connection
@@ -32,13 +39,177 @@ struct Connection
   // in units of mass per units of time.
 };
 
+// Heat exchange between two sections, which don't need to be
+// connected, nor to belong to the same circuit.
+struct ThermalLink
+{
+  Section* sections[2];
+  float conductance; // fraction of the temperature difference exchanged per unit of time
+};
+
+// A scheduled change of an actuator (valve opening, pump flux, ...),
+// applied at the start of simulation tick 'tick', and optionally ramped
+// linearly over 'duration' ticks. A new event on the same target
+// cancels any ramp still in progress. Events due on the same tick
+// are applied in the order they were scheduled.
+struct ActuatorEvent
+{
+  int tick;
+  float* target; // e.g &section.damping
+  float value;
+  int duration = 0;
+  int sequence = 0; // set by schedule()
+};
+
+struct Ramp
+{
+  float* target;
+  float from, to;
+  int begin, end; // ticks
+};
+
+// Sparse adjacency matrix of the sections of a circuit, in compressed
+// row form: the neighbours of section i are
+// neighbours[first[i]] ... neighbours[first[i + 1] - 1].
+// Derived from the connections, rebuilt by the solver when they change.
+struct Adjacency
+{
+  Array<int> first;
+  Array<int> neighbours;
+  Array<int> edges; // index of the connection to each neighbour
+  int connectionCount = -1;
+};
+
+// All the arrays use the storage backing current at construction,
+// so a circuit can be larger than RAM (see storage.h).
 struct Circuit
 {
   // [Section 0] -> [Flux 0] -> [Section 1] -> [Flux 1] ...
-  std::vector<Section> sections;
-  std::vector<Connection> connections;
+  Array<Section> sections;
+  Array<Connection> connections;
+
+  // Applied when this circuit is updated. When a link crosses circuits,
+  // it should belong to the one with the shortest period.
+  Array<ThermalLink> thermalLinks;
+
+  float ambientT = 25.0; // temperature cooling sections relax to
+
+  // Heat conduction through the walls of connected sections, as a fraction
+  // of the temperature difference per unit of time (0 = disabled).
+  // The explicit scheme requires wallConductance * period * degree < 1,
+  // the implicit one is stable for any period: it solves for the end of
+  // the period with conjugate gradients, to a relative residual of 1e-5.
+  // Heat is conserved whether or not it has converged. The iteration count
+  // grows with sqrt(wallConductance * period), and is at most the number
+  // of sections.
+  float wallConductance = 0;
+  bool implicitConduction = false;
+
+  // Number of simulation ticks between two updates of this circuit.
+  // Loops with slow dynamics can use a longer period: each update then
+  // integrates over the whole period at once, and between two updates,
+  // the state of the circuit is held as-is for whoever reads it.
+  // Beware: long periods can make the integration unstable.
+  int period = 1;
+
+  // Actuator changes. Only the targets of the events firing on a tick,
+  // and the ramps in progress, get touched.
+  Array<ActuatorEvent> events; // min-heap on (tick, sequence)
+  int scheduledCount = 0; // next event sequence number
+  Array<Ramp> ramps;
+  std::unordered_map<float*, int> rampOf; // index in 'ramps', by target
+
+  // solver workspace
+  Adjacency adjacency;
+  Array<double> scratch;
+  bool chained = false; // connection i goes from section i to section i + 1
+  int chainedConnectionCount = -1;
 };
 
 void connectSections(Circuit& circuit, Section& a, Section& b);
-void simulate(Circuit& circuit);
+void connectThermal(Circuit& circuit, Section& a, Section& b, float conductance);
+void schedule(Circuit& circuit, ActuatorEvent event);
+
+// Sorts the connections on their first section, so the solver passes
+// over the connections walk the sections in memory order.
+// This changes the transfer order, hence the results, slightly.
+void sortConnections(Circuit& circuit);
+
+// Advances the circuit to simulation tick 'tick'.
+// Actuator events are processed on every tick, but the rest of the work
+// is only done when 'tick' is a multiple of the circuit period.
+void simulate(Circuit& circuit, int tick = 0);
+
+// The two phases of simulate(), for callers updating circuits in parallel:
+// advance() only touches the sections of the circuit and the targets of its
+// actuator events, while exchangeHeat() also touches the other end of its
+// thermal links.
+void advance(Circuit& circuit, int tick);
+void exchangeHeat(Circuit& circuit, int tick);
+
+// Advances the circuit by 'steps' updates, for fast-forward and offline runs.
+// Temporally blocked: each tile of 'tileSize' consecutive sections is
+// advanced by all the steps at once while it's hot in cache, along with
+// a halo of neighbouring sections that is discarded afterwards. Each section
+// is then read and written once per call, instead of several times per step.
+// Results are close to, but not bit-identical with, calling simulate():
+// thermal links are applied once per block, and the transfer pass being
+// order-dependent, a temperature change can travel further than one section
+// per step, which the halo only partly covers. The error fades quickly with
+// the halo width (2 sections per step): none is measurable on the benchmark
+// ring (bench.exe), but a single step with strong flows can be off by 0.08C.
+// Actuator events aren't processed.
+void simulateBlocked(Circuit& circuit, int steps, int tileSize = 4096);
+
+// Reduced-precision storage of a circuit, for very large networks where
+// memory bandwidth is the limit. Mass and temperature are stored as 16-bit
+// fixed point, and the other section quantities are deduplicated into a
+// table of section types: 6 bytes per section instead of 32.
+// Values are only widened to float inside simulateBlocked().
+// Each update rounds mass and temperature to a multiple of their scale.
+// The mass rounding error is carried over to the next section written, so
+// the total mass is conserved. Temperatures are only rounded: the error is
+// at most half a scale unit per update. bench.exe reports both.
+struct PackedSection
+{
+  uint16_t mass; // times massScale
+  uint16_t T; // times temperatureScale
+  uint16_t type; // index in the type table
+};
+
+struct PackedConnection
+{
+  int sections[2];
+  float flux;
+};
+
+struct PackedCircuit
+{
+  Array<PackedSection> sections;
+  Array<PackedConnection> connections;
+  std::vector<Section> types;
+
+  float massScale = 1;
+  float temperatureScale = 1;
+  float massCarry = 0; // rounding error not stored yet, below one scale unit
+
+  // see Circuit
+  int period = 1;
+  float ambientT = 25.0;
+  float wallConductance = 0;
+  bool implicitConduction = false;
+
+  // solver workspace
+  Adjacency adjacency;
+};
+
+// Scales leave room for values up to 4 times the current maximum,
+// beyond that, they saturate.
+// Thermal links and actuator events aren't carried over.
+PackedCircuit pack(const Circuit& circuit);
+
+// Writes the state back to the circuit 'packed' was created from.
+// The mass carry goes to the first section.
+void unpack(const PackedCircuit& packed, Circuit& circuit);
 
+void simulateBlocked(PackedCircuit& packed, int steps, int tileSize = 4096);
@@ -0,0 +1,33 @@
+// Fixed-capacity vector, never allocates.
+#pragma once
+
+#include <assert.h>
+#include <initializer_list>
+
+template<typename T, int N>
+struct StaticVector
+{
+  StaticVector() = default;
+
+  StaticVector(std::initializer_list<T> list)
+  {
+    for(auto& item : list)
+      push_back(item);
+  }
+
+  void push_back(const T& item)
+  {
+    assert(count < N);
+    items[count++] = item;
+  }
+
+  int size() const { return count; }
+  const T* begin() const { return items; }
+  const T* end() const { return items + count; }
+  const T& operator [] (int i) const { return items[i]; }
+  T& operator [] (int i) { return items[i]; }
+
+private:
+  T items[N] {};
+  int count = 0;
+};
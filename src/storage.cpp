@@ -0,0 +1,137 @@
+#include "storage.h"
+#include <algorithm>
+#include <new> // bad_alloc
+#include <stdlib.h>
+#include <string>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+Backing g_backing = Backing::Heap;
+std::string g_directory = ".";
+
+#ifdef __linux__
+auto const HUGE_PAGE_SIZE = size_t(2) << 20;
+
+size_t roundToHugePage(size_t size)
+{
+  return (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+}
+
+void* mapAnonymous(size_t size, bool explicitHugePages)
+{
+  void* p = MAP_FAILED;
+
+  if(explicitHugePages)
+    p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+  if(p == MAP_FAILED)
+  {
+    p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if(p == MAP_FAILED)
+      throw std::bad_alloc();
+
+    madvise(p, size, MADV_HUGEPAGE);
+  }
+
+  return p;
+}
+
+void* mapFile(size_t size)
+{
+  auto path = g_directory + "/reeactor-XXXXXX";
+  int fd = mkstemp(&path[0]);
+
+  if(fd < 0)
+    throw std::bad_alloc();
+
+  // the mapping keeps the file alive, nobody else needs to see it
+  unlink(path.c_str());
+
+  void* p = MAP_FAILED;
+
+  if(ftruncate(fd, size) == 0)
+    p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+  close(fd);
+
+  if(p == MAP_FAILED)
+    throw std::bad_alloc();
+
+  // the solver streams through its arrays
+  madvise(p, size, MADV_SEQUENTIAL);
+
+  return p;
+}
+#endif
+}
+
+void setStorageBacking(Backing backing, const char* directory)
+{
+  g_backing = backing;
+  g_directory = directory;
+}
+
+Backing getStorageBacking()
+{
+  return g_backing;
+}
+
+void* allocateStorage(size_t size, Backing backing)
+{
+  if(size == 0)
+    return nullptr;
+
+#ifdef __linux__
+
+  switch(backing)
+  {
+  case Backing::Heap:
+    break;
+  case Backing::File:
+    return mapFile(size);
+  case Backing::TransparentHugePages:
+    return mapAnonymous(roundToHugePage(size), false);
+  case Backing::HugePages:
+    return mapAnonymous(roundToHugePage(size), true);
+  }
+
+#endif
+
+  void* p = malloc(size);
+
+  if(!p)
+    throw std::bad_alloc();
+
+  return p;
+}
+
+void freeStorage(void* p, size_t size, Backing backing)
+{
+  if(!p)
+    return;
+
+#ifdef __linux__
+
+  switch(backing)
+  {
+  case Backing::Heap:
+    break;
+  case Backing::File:
+    munmap(p, size);
+    return;
+  case Backing::TransparentHugePages:
+  case Backing::HugePages:
+    munmap(p, roundToHugePage(size));
+    return;
+  }
+
+#endif
+
+  free(p);
+}
@@ -0,0 +1,56 @@
+// Allocation of the big solver arrays.
+#pragma once
+
+#include <stddef.h>
+#include <type_traits>
+#include <vector>
+
+enum class Backing
+{
+  Heap,
+  File, // memory-mapped temporary file, for state larger than RAM
+  TransparentHugePages, // anonymous mapping, advised to use huge pages
+  HugePages, // explicit huge pages (MAP_HUGETLB), or transparent ones if none are reserved
+};
+
+// There is no NUMA placement: pages land on the node of the thread
+// that first writes them, usually the one building the circuit.
+
+// Backing of the arrays created from now on.
+// Mapped files are created (and immediately unlinked) in 'directory',
+// which should be on disk: /tmp is often a tmpfs, where a mapped file
+// is just more RAM. Hence the working directory by default.
+// The mapped backings are Linux only: elsewhere, everything is on the heap.
+void setStorageBacking(Backing backing, const char* directory = ".");
+Backing getStorageBacking();
+
+void* allocateStorage(size_t size, Backing backing);
+void freeStorage(void* p, size_t size, Backing backing);
+
+// Keeps the backing it was created with, so a container
+// always releases its memory the way it was allocated.
+template<typename T>
+struct StorageAllocator
+{
+  using value_type = T;
+  using propagate_on_container_copy_assignment = std::true_type;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap = std::true_type;
+
+  StorageAllocator() = default;
+  explicit StorageAllocator(Backing backing_) : backing(backing_) {}
+
+  template<typename U>
+  StorageAllocator(const StorageAllocator<U>& other) : backing(other.backing) {}
+
+  T* allocate(size_t n) { return (T*)allocateStorage(n * sizeof(T), backing); }
+  void deallocate(T* p, size_t n) { freeStorage(p, n * sizeof(T), backing); }
+
+  bool operator == (const StorageAllocator& other) const { return backing == other.backing; }
+  bool operator != (const StorageAllocator& other) const { return backing != other.backing; }
+
+  Backing backing = getStorageBacking();
+};
+
+template<typename T>
+using Array = std::vector<T, StorageAllocator<T>>;
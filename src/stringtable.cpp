@@ -0,0 +1,141 @@
+#include "stringtable.h"
+#include <algorithm>
+#include <string.h>
+
+namespace
+{
+auto const BLOCK_SIZE = 64 * 1024;
+
+// FNV-1a
+unsigned hash(const char* s)
+{
+  unsigned h = 2166136261u;
+
+  while(*s)
+    h = (h ^ (unsigned char)*s++) * 16777619u;
+
+  return h;
+}
+}
+
+int StringTable::intern(const char* s)
+{
+  auto const h = hash(s);
+
+  // keep the load factor under 1/2
+  if(2 * (size() + 1) > (int)slots.size())
+    rehash(std::max<int>(64, slots.size() * 2));
+
+  auto i = h & (slots.size() - 1);
+
+  while(slots[i] != -1)
+  {
+    auto const handle = slots[i];
+
+    if(hashes[handle] == h && !strcmp(strings[handle], s))
+      return handle;
+
+    i = (i + 1) & (slots.size() - 1);
+  }
+
+  auto const handle = size();
+  slots[i] = handle;
+  strings.push_back(store(s));
+  hashes.push_back(h);
+  sorted.clear();
+  return handle;
+}
+
+void StringTable::reserve(int count)
+{
+  strings.reserve(count);
+  hashes.reserve(count);
+
+  int slotCount = std::max<int>(64, slots.size());
+
+  while(slotCount < 2 * count)
+    slotCount *= 2;
+
+  if(slotCount > (int)slots.size())
+    rehash(slotCount);
+}
+
+int StringTable::find(const char* s) const
+{
+  if(slots.empty())
+    return -1;
+
+  auto const h = hash(s);
+  auto i = h & (slots.size() - 1);
+
+  while(slots[i] != -1)
+  {
+    auto const handle = slots[i];
+
+    if(hashes[handle] == h && !strcmp(strings[handle], s))
+      return handle;
+
+    i = (i + 1) & (slots.size() - 1);
+  }
+
+  return -1;
+}
+
+View<const int> StringTable::withPrefix(const char* prefix)
+{
+  if((int)sorted.size() != size())
+  {
+    sorted.resize(size());
+
+    for(int handle = 0; handle < size(); ++handle)
+      sorted[handle] = handle;
+
+    std::sort(sorted.begin(), sorted.end(), [&] (int a, int b) { return strcmp(strings[a], strings[b]) < 0; });
+  }
+
+  auto const n = strlen(prefix);
+  auto const first = std::lower_bound(sorted.begin(), sorted.end(), prefix, [&] (int handle, const char* p) { return strcmp(strings[handle], p) < 0; });
+  auto last = first;
+
+  while(last != sorted.end() && !strncmp(strings[*last], prefix, n))
+    ++last;
+
+  return { sorted.data() + (first - sorted.begin()), sorted.data() + (last - sorted.begin()) };
+}
+
+void StringTable::clear()
+{
+  *this = {};
+}
+
+void StringTable::rehash(int slotCount)
+{
+  slots.assign(slotCount, -1);
+
+  for(int handle = 0; handle < size(); ++handle)
+  {
+    auto i = hashes[handle] & (slots.size() - 1);
+
+    while(slots[i] != -1)
+      i = (i + 1) & (slots.size() - 1);
+
+    slots[i] = handle;
+  }
+}
+
+const char* StringTable::store(const char* s)
+{
+  auto const n = (int)strlen(s) + 1;
+
+  if(blockUsed + n > blockSize)
+  {
+    blockSize = std::max(n, BLOCK_SIZE);
+    blocks.emplace_back(new char[blockSize]);
+    blockUsed = 0;
+  }
+
+  auto r = blocks.back().get() + blockUsed;
+  memcpy(r, s, n);
+  blockUsed += n;
+  return r;
+}
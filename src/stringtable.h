@@ -0,0 +1,41 @@
+// Interned strings, referred to by compact integer handles.
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "view.h"
+
+struct StringTable
+{
+  // returns the handle of 's', adding it if needed
+  int intern(const char* s);
+
+  // returns -1 if 's' was never interned
+  int find(const char* s) const;
+
+  // stays valid until clear()
+  const char* get(int handle) const { return strings[handle]; }
+
+  int size() const { return (int)strings.size(); }
+
+  // makes room for 'count' strings in total
+  void reserve(int count);
+
+  // handles of the strings starting with 'prefix', in lexicographic order.
+  // The first call after an intern() sorts the table.
+  View<const int> withPrefix(const char* prefix);
+
+  void clear();
+
+private:
+  const char* store(const char* s);
+  void rehash(int slotCount);
+
+  std::vector<const char*> strings; // by handle
+  std::vector<unsigned> hashes; // by handle
+  std::vector<int> slots; // open addressing, linear probing. -1 if empty
+  std::vector<int> sorted; // handles, by string
+  std::vector<std::unique_ptr<char[]>> blocks; // characters, never move
+  int blockUsed = 0;
+  int blockSize = 0;
+};
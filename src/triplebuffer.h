@@ -0,0 +1,40 @@
+// Lock-free publication of a value, from one writer thread to one reader thread.
+#pragma once
+
+#include <atomic>
+
+// The writer fills back() then publishes it, the reader picks up
+// the latest published value with update(), then reads front().
+// Neither side ever waits for the other: the third buffer is the one
+// published but not yet picked up.
+template<typename T>
+struct TripleBuffer
+{
+  T& back() { return buffers[backIndex]; }
+
+  void publish()
+  {
+    backIndex = middle.exchange(backIndex | FRESH) & INDEX;
+  }
+
+  // returns false if nothing was published since the last call
+  bool update()
+  {
+    if(!(middle.load() & FRESH))
+      return false;
+
+    frontIndex = middle.exchange(frontIndex) & INDEX;
+    return true;
+  }
+
+  const T& front() const { return buffers[frontIndex]; }
+
+private:
+  static auto const INDEX = 3;
+  static auto const FRESH = 4;
+
+  T buffers[3] {};
+  int backIndex = 0; // writer side
+  int frontIndex = 1; // reader side
+  std::atomic<int> middle { 2 };
+};
@@ -0,0 +1,66 @@
+// Non-owning ranges, iterated in place: never copy nor allocate.
+#pragma once
+
+// Contiguous range of elements.
+template<typename T>
+struct View
+{
+  View() = default;
+  View(T* first_, T* last_) : first(first_), last(last_) {}
+
+  int size() const { return last - first; }
+  T* begin() const { return first; }
+  T* end() const { return last; }
+  T& operator [] (int i) const { return first[i]; }
+
+private:
+  T* first = nullptr;
+  T* last = nullptr;
+};
+
+// Elements of a range matching a predicate, skipped lazily.
+template<typename Iterator, typename Predicate>
+struct FilteredView
+{
+  struct iterator
+  {
+    Iterator pos;
+    Iterator last;
+    const Predicate* pred;
+
+    auto& operator * () const { return *pos; }
+    bool operator != (const iterator& other) const { return pos != other.pos; }
+
+    iterator& operator ++ ()
+    {
+      ++pos;
+      skip();
+      return *this;
+    }
+
+    void skip()
+    {
+      while(pos != last && !(*pred)(*pos))
+        ++pos;
+    }
+  };
+
+  iterator begin() const
+  {
+    iterator i { first, last, &pred };
+    i.skip();
+    return i;
+  }
+
+  iterator end() const { return { last, last, &pred }; }
+
+  Iterator first;
+  Iterator last;
+  Predicate pred;
+};
+
+template<typename Range, typename Predicate>
+auto filter(const Range& range, Predicate pred)
+{
+  return FilteredView<decltype(range.begin()), Predicate> { range.begin(), range.end(), pred };
+}
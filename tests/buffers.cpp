@@ -0,0 +1,108 @@
+#include "tests.h"
+#include <thread>
+#include "ringbuffer.h"
+#include "triplebuffer.h"
+
+TEST(tripleBufferPublishesTheLatestValue)
+{
+  TripleBuffer<int> buffer;
+  CHECK(!buffer.update());
+
+  buffer.back() = 1;
+  buffer.publish();
+  buffer.back() = 2;
+  buffer.publish();
+
+  CHECK(buffer.update());
+  CHECK(buffer.front() == 2);
+  CHECK(!buffer.update());
+  CHECK(buffer.front() == 2);
+}
+
+TEST(tripleBufferNeverTearsAcrossThreads)
+{
+  struct Value
+  {
+    int a = 0;
+    int b = 0;
+  };
+
+  TripleBuffer<Value> buffer;
+  auto const LAST = 200000;
+
+  std::thread writer([&] ()
+    {
+      for(int i = 1; i <= LAST; ++i)
+      {
+        buffer.back() = { i, -i };
+        buffer.publish();
+      }
+    });
+
+  int previous = 0;
+  bool consistent = true;
+
+  while(previous < LAST)
+  {
+    if(!buffer.update())
+      continue;
+
+    auto& value = buffer.front();
+    consistent = consistent && value.a == -value.b && value.a > previous;
+    previous = value.a;
+  }
+
+  writer.join();
+  CHECK(consistent);
+}
+
+TEST(ringBufferIsFifoAndBounded)
+{
+  RingBuffer<int, 4> queue;
+  int value;
+  CHECK(!queue.pop(value));
+
+  for(int i = 0; i < 4; ++i)
+    CHECK(queue.push(i));
+
+  CHECK(!queue.push(4));
+
+  for(int i = 0; i < 4; ++i)
+  {
+    CHECK(queue.pop(value));
+    CHECK(value == i);
+    CHECK(queue.push(i + 4)); // wraps around
+  }
+
+  CHECK(queue.pop(value));
+  CHECK(value == 4);
+}
+
+TEST(ringBufferDeliversEverythingAcrossThreads)
+{
+  RingBuffer<int, 64> queue;
+  auto const COUNT = 200000;
+
+  std::thread producer([&] ()
+    {
+      for(int i = 0; i < COUNT; ++i)
+      {
+        while(!queue.push(i))
+          std::this_thread::yield();
+      }
+    });
+
+  int expected = 0;
+  bool ordered = true;
+
+  while(expected < COUNT)
+  {
+    int value;
+
+    if(queue.pop(value))
+      ordered = ordered && value == expected++;
+  }
+
+  producer.join();
+  CHECK(ordered);
+}
@@ -0,0 +1,67 @@
+#include "tests.h"
+#include "staticvector.h"
+#include "view.h"
+
+TEST(staticVectorHoldsItsItemsInPlace)
+{
+  StaticVector<int, 4> v;
+  CHECK(v.size() == 0);
+  CHECK(v.begin() == v.end());
+
+  v.push_back(1);
+  v.push_back(2);
+  CHECK(v.size() == 2);
+  CHECK(v[0] == 1 && v[1] == 2);
+
+  v[1] = 5;
+  int sum = 0;
+
+  for(auto item : v)
+    sum += item;
+
+  CHECK(sum == 6);
+
+  // copies are independent
+  auto copy = v;
+  copy[0] = 9;
+  CHECK(v[0] == 1);
+
+  StaticVector<int, 4> list { 3, 4, 5, 6 };
+  CHECK(list.size() == 4);
+  CHECK(list[3] == 6);
+}
+
+TEST(viewsIterateInPlace)
+{
+  int items[] = { 1, 2, 3, 4, 5, 6 };
+  View<int> view(items + 1, items + 5);
+  CHECK(view.size() == 4);
+  CHECK(view[0] == 2);
+
+  view[3] = 50; // writes through
+  CHECK(items[4] == 50);
+
+  auto isEven = [] (int value) { return value % 2 == 0; };
+  int evens[6];
+  int count = 0;
+
+  for(auto& item : filter(view, isEven))
+    evens[count++] = item;
+
+  CHECK(count == 3);
+  CHECK(evens[0] == 2 && evens[1] == 4 && evens[2] == 50);
+
+  // nothing matching, or nothing at all
+  auto countOf = [] (auto range)
+    {
+      int r = 0;
+
+      for(auto it = range.begin(); it != range.end(); ++it)
+        ++r;
+
+      return r;
+    };
+
+  CHECK(countOf(filter(view, [] (int) { return false; })) == 0);
+  CHECK(countOf(filter(View<int>(), isEven)) == 0);
+}
@@ -0,0 +1,283 @@
+#include "tests.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <map>
+#include <set>
+#include <string>
+#include "game.h"
+
+namespace
+{
+auto const PUMP_ENABLE = 0; // in EPump::introspect()
+auto const PUMP_POWER = 1;
+auto const REACTOR_TEMPERATURE = 1; // in EReactor::introspect()
+auto const EXCHANGER_TEMPERATURE = 0; // in EHeatExchanger::introspect()
+
+int findActor(const char* name)
+{
+  return GameGetActorIndex(GameFindId(name));
+}
+}
+
+TEST(commandsAreStampedAndLoggedWhenApplied)
+{
+  GameInit();
+  auto const pump = findActor("[Primary Circuit] Pump 1");
+  CHECK(pump >= 0);
+
+  for(int tick = 0; tick < 5; ++tick)
+    GameTick();
+
+  CHECK(GameSetProperty(pump, PUMP_POWER, 0.25f));
+  CHECK(GameSetProperty(pump, PUMP_POWER, 0.5f));
+  GameTick();
+  GameTick();
+  CHECK(GameSetProperty(pump, PUMP_POWER, 0.75f));
+  GameTick();
+
+  auto const log = GameGetCommandLog();
+  CHECK(log.size() == 3);
+
+  if(log.size() == 3)
+  {
+    CHECK(log[0].tick == 5 && log[0].floatValue == 0.25f);
+    CHECK(log[1].tick == 5 && log[1].floatValue == 0.5f);
+    CHECK(log[2].tick == 7 && log[2].floatValue == 0.75f);
+  }
+
+  auto& state = GameGetState();
+  CHECK(state.tick == 8);
+  CHECK(state.actors[pump].properties[PUMP_POWER].value == 0.75f);
+
+  GameInit();
+  CHECK(GameGetCommandLog().size() == 0);
+}
+
+TEST(commandQueueRefusesCommandsWhenFull)
+{
+  GameInit();
+  auto const pump = findActor("[Primary Circuit] Pump 1");
+  int queued = 0;
+
+  while(queued < 10000 && GameSetProperty(pump, PUMP_POWER, 0.5f))
+    ++queued;
+
+  CHECK(queued > 0);
+  CHECK(queued < 10000);
+
+  // a tick makes room again
+  GameTick();
+  CHECK(GameGetCommandLog().size() == queued);
+  CHECK(GameSetProperty(pump, PUMP_POWER, 0.5f));
+
+  GameInit();
+}
+
+TEST(actorsDescribeThemselvesWithinTheirLimits)
+{
+  GameInit();
+
+  for(auto actor : GameGetActors())
+  {
+    CHECK(actor->sprite().size() <= Actor::MAX_SPRITES);
+    CHECK(actor->introspect().size() <= Actor::MAX_PROPERTIES);
+  }
+
+  // and the published state holds all of it
+  auto& state = GameGetState();
+  CHECK((int)state.actors.size() == (int)GameGetActors().size());
+
+  for(auto& actor : state.actors)
+  {
+    CHECK(actor.sprites.size() == actor.actor->sprite().size());
+    CHECK(actor.propertyCount == actor.actor->introspect().size());
+  }
+}
+
+TEST(propertiesAreReadAndWrittenThroughTheirTables)
+{
+  GameInit();
+  auto const pump = findActor("[Primary Circuit] Pump 1");
+  auto const reactor = findActor("Reactor Core");
+  auto const exchanger = findActor("Primary Heat Exchanger");
+
+  auto& before = GameGetState();
+  CHECK(before.actors[pump].properties[PUMP_ENABLE].value == 1);
+  CHECK(before.actors[reactor].properties[REACTOR_TEMPERATURE].value == 200);
+
+  CHECK(GameSetProperty(pump, PUMP_ENABLE, false));
+  CHECK(GameSetProperty(pump, PUMP_POWER, 2.0f)); // clamped to the range
+  CHECK(GameSetProperty(reactor, REACTOR_TEMPERATURE, 0.0f)); // read-only: ignored
+  GameTick();
+
+  auto& after = GameGetState();
+  CHECK(after.actors[pump].properties[PUMP_ENABLE].value == 0);
+  CHECK(after.actors[pump].properties[PUMP_POWER].value == 1);
+  CHECK(after.actors[reactor].properties[REACTOR_TEMPERATURE].value > 20); // the reading, not 0
+  CHECK(after.actors[exchanger].propertyCount == 1);
+  CHECK(after.actors[exchanger].properties[EXCHANGER_TEMPERATURE].value > 20);
+}
+
+TEST(idsAreFoundByNameAndPrefix)
+{
+  GameInit();
+  CHECK(GameFindId("no such id") == -1);
+  CHECK(GameGetActorIndex(-1) == -1);
+  CHECK(*GameGetIdName(-1) == 0);
+
+  auto const core = GameFindId("Reactor Core");
+  CHECK(core >= 0);
+  CHECK(GameGetActors()[GameGetActorIndex(core)]->id == core);
+
+  auto const pumps = GameFindIds("[Primary Circuit] Pump ");
+  CHECK(pumps.size() == 2);
+
+  if(pumps.size() == 2)
+  {
+    CHECK(pumps[0] == GameFindId("[Primary Circuit] Pump 1"));
+    CHECK(pumps[1] == GameFindId("[Primary Circuit] Pump 2"));
+  }
+
+  // every id is found through the empty prefix, each once
+  int count = 0;
+
+  for(auto actor : GameGetActors())
+    count += actor->id >= 0;
+
+  CHECK(GameFindIds("").size() == count);
+}
+
+TEST(unitCopiesAreLaidOutAndWiredLikeTheFirstUnit)
+{
+  auto const UNITS = 3;
+  auto const TICKS = 100;
+
+  GameInitPlant(1, 7);
+
+  for(int tick = 0; tick < TICKS; ++tick)
+    GameTick();
+
+  auto const alone = GameGetState().actors;
+
+  GameInitPlant(UNITS, 7);
+  auto const initial = GameGetState().actors;
+
+  for(int tick = 0; tick < TICKS; ++tick)
+    GameTick();
+
+  auto& state = GameGetState();
+
+  // units are contiguous in GameGetActors(), the first one being the original
+  auto const unitSize = (int)alone.size();
+  CHECK((int)state.actors.size() == UNITS * unitSize);
+
+  if((int)state.actors.size() != UNITS * unitSize)
+    return;
+
+  // the copies don't disturb the first unit
+  for(int i = 0; i < unitSize; ++i)
+  {
+    CHECK_NEAR(state.actors[i].mass, alone[i].mass, 1e-3 * fabs(alone[i].mass));
+    CHECK_NEAR(state.actors[i].temperature, alone[i].temperature, 1e-3);
+    CHECK_NEAR(state.actors[i].flux0, alone[i].flux0, 1e-3);
+  }
+
+  auto const core = findActor("Reactor Core");
+
+  for(int unit = 2; unit <= UNITS; ++unit)
+  {
+    char prefix[32];
+    snprintf(prefix, sizeof prefix, "[Unit %d] ", unit);
+    auto const first = (unit - 1) * unitSize;
+    auto const copyOf = [&] (int original)
+      {
+        return findActor((prefix + std::string(GameGetIdName(state.actors[original].actor->id))).c_str());
+      };
+
+    auto const offset = state.actors[copyOf(core)].actor->pos - state.actors[core].actor->pos;
+    CHECK(offset.x != 0 || offset.y != 0);
+
+    std::map<std::string, int> types; // count by type, original minus copies
+    double massBefore = 0;
+    double massAfter = 0;
+
+    for(int i = 0; i < unitSize; ++i)
+    {
+      ++types[state.actors[i].actor->name()];
+      --types[state.actors[first + i].actor->name()];
+      massBefore += initial[first + i].mass;
+      massAfter += state.actors[first + i].mass;
+
+      if(state.actors[i].actor->id < 0)
+        continue;
+
+      auto const copyIndex = copyOf(i);
+      CHECK(copyIndex >= first && copyIndex < first + unitSize);
+
+      if(copyIndex < 0)
+        continue;
+
+      auto original = state.actors[i].actor;
+      auto copy = state.actors[copyIndex].actor;
+      CHECK(strcmp(copy->name(), original->name()) == 0);
+      CHECK_NEAR(copy->pos.x, original->pos.x + offset.x, 1e-4);
+      CHECK_NEAR(copy->pos.y, original->pos.y + offset.y, 1e-4);
+    }
+
+    for(auto& type : types)
+      CHECK(type.second == 0);
+
+    // water only moves within the unit's own circuits
+    CHECK_NEAR(massAfter, massBefore, 1e-5 * massBefore);
+
+    // and it does move
+    auto const pump = copyOf(findActor("[Primary Circuit] Pump 1"));
+    CHECK(pump >= 0 && fabs(state.actors[pump].flux0) > 0.1);
+  }
+
+  GameInit();
+}
+
+TEST(onlyTheVisibleAreaGetsFreshReadings)
+{
+  GameInitPlant(2, 7);
+  auto const pump = findActor("[Primary Circuit] Pump 1");
+  auto const hiddenPump = findActor("[Unit 2] [Primary Circuit] Pump 1");
+  auto const selectedValve = findActor("[Unit 2] [Primary Circuit] Main Pre-Valve 1");
+  auto const unitOffset = GameGetActors()[hiddenPump]->pos.x - GameGetActors()[pump]->pos.x;
+  CHECK(unitOffset > 0);
+
+  // the first unit, and a selection in the second one
+  GameGetState();
+  GameSetVisibleArea(Vec2f(-100, -100), Vec2f(unitOffset - 0.5f, 100), selectedValve);
+
+  std::set<float> early[3];
+  auto const watched = { pump, hiddenPump, selectedValve };
+
+  for(int tick = 0; tick < 5; ++tick)
+  {
+    auto& state = GameGetState();
+    int k = 0;
+
+    for(int i : watched)
+      early[k++].insert(state.actors[i].flux0);
+
+    GameTick();
+  }
+
+  for(int tick = 0; tick < 30; ++tick)
+    GameTick();
+
+  auto& state = GameGetState();
+  CHECK((int)state.actors.size() == (int)GameGetActors().size());
+  CHECK(!early[0].count(state.actors[pump].flux0));
+  CHECK(early[1].count(state.actors[hiddenPump].flux0)); // stale
+  CHECK(!early[2].count(state.actors[selectedValve].flux0));
+
+  // the static data is always there
+  CHECK(state.actors[hiddenPump].actor == GameGetActors()[hiddenPump]);
+  CHECK(state.actors[hiddenPump].propertyCount == 2);
+
+  GameInit();
+}
@@ -0,0 +1,54 @@
+#include "tests.h"
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+namespace
+{
+struct Test
+{
+  const char* name;
+  void (* func)();
+};
+
+// function-local: registrations run during static initialization
+std::vector<Test>& tests()
+{
+  static std::vector<Test> instance;
+  return instance;
+}
+
+int g_failures;
+}
+
+void registerTest(const char* name, void (* func)())
+{
+  tests().push_back({ name, func });
+}
+
+void reportFailure(const char* file, int line, const char* expr)
+{
+  fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expr);
+  ++g_failures;
+}
+
+// usage: tests.exe [name filter]
+int main(int argc, char* argv[])
+{
+  auto const filter = argc > 1 ? argv[1] : "";
+  int count = 0;
+
+  for(auto& test : tests())
+  {
+    if(!strstr(test.name, filter))
+      continue;
+
+    auto const failuresBefore = g_failures;
+    test.func();
+    printf("%s %s\n", g_failures == failuresBefore ? "[ OK ]" : "[FAIL]", test.name);
+    ++count;
+  }
+
+  printf("%d tests, %d failed checks\n", count, g_failures);
+  return g_failures ? 1 : 0;
+}
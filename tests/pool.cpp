@@ -0,0 +1,56 @@
+#include "tests.h"
+#include "pool.h"
+
+namespace
+{
+struct Object
+{
+  int value = 7;
+};
+}
+
+TEST(poolConstructsObjectsInBlocks)
+{
+  Pool<Object> pool;
+  auto a = pool.allocate(10);
+  auto b = pool.allocate(20);
+
+  CHECK(pool.blocks.size() == 1);
+  CHECK(b.begin() == a.end());
+  CHECK(pool.blocks[0].size() == 30);
+  CHECK(a[0].value == 7 && b[19].value == 7);
+
+  // a request larger than a block gets a block of its own
+  auto big = pool.allocate(Pool<Object>::BLOCK_SIZE * 3);
+  CHECK(pool.blocks.size() == 2);
+  CHECK(pool.blocks[1].begin() == big.begin());
+
+  Object source[2];
+  source[1].value = 42;
+  auto copies = pool.allocate(source, 2);
+  CHECK(copies[1].value == 42);
+}
+
+TEST(poolReserveKeepsLaterAllocationsContiguous)
+{
+  Pool<Object> pool;
+  auto first = pool.allocate(10);
+  first[0].value = 1;
+
+  auto const COUNT = 5000;
+  pool.reserve(COUNT);
+  CHECK(pool.blocks.size() == 2);
+
+  for(int i = 0; i < COUNT / 5; ++i)
+    pool.allocate(5);
+
+  // no new block, and the objects allocated first didn't move
+  CHECK(pool.blocks.size() == 2);
+  CHECK(pool.blocks[1].size() == COUNT);
+  CHECK(pool.blocks[0].begin() == first.begin());
+  CHECK(first[0].value == 1);
+
+  // nothing to do when there's already room
+  pool.reserve(0);
+  CHECK(pool.blocks.size() == 2);
+}
@@ -0,0 +1,44 @@
+#include "tests.h"
+#include <math.h>
+#include "random.h"
+
+TEST(randomFloatsAreUniformInUnitInterval)
+{
+  auto const COUNT = 100000;
+  int buckets[10] {};
+  double sum = 0;
+
+  for(int i = 0; i < COUNT; ++i)
+  {
+    auto const value = randomFloat(123, i);
+    CHECK(value >= 0 && value < 1);
+    ++buckets[int(value * 10)];
+    sum += value;
+  }
+
+  CHECK_NEAR(sum / COUNT, 0.5, 0.01);
+
+  for(auto count : buckets)
+    CHECK_NEAR(count, COUNT / 10, COUNT / 100);
+}
+
+TEST(randomStreamsArePureFunctionsOfTheirKey)
+{
+  // same inputs, same outputs, in any order
+  CHECK(randomFloat(7, 1000) == randomFloat(7, 1000));
+  CHECK(randomKey(1, 2) == randomKey(1, 2));
+
+  // known values: the same on every platform
+  CHECK(mix(0) == 0xE220A8397B1DCDAFull);
+  CHECK(randomFloat(0, 0) == 0xE220A8 / float(1 << 24)); // top 24 bits
+
+  // neighbouring keys give unrelated streams
+  int same = 0;
+
+  for(int i = 0; i < 1000; ++i)
+    same += randomFloat(randomKey(42, 1), i) == randomFloat(randomKey(42, 2), i);
+
+  CHECK(same == 0);
+  CHECK(randomKey(42, 1) != randomKey(42, 2));
+  CHECK(randomKey(1, 2) != randomKey(2, 1));
+}
@@ -0,0 +1,53 @@
+#include "tests.h"
+#include <atomic>
+#include "scheduler.h"
+
+TEST(schedulerRunsTasksAfterTheirDependencies)
+{
+  for(int threadCount : { 0, 1, 3 })
+  {
+    Scheduler scheduler(threadCount);
+    TaskGraph graph;
+
+    // a diamond per lane: fork -> 4 branches -> join
+    auto const LANES = 50;
+    std::atomic<int> order { 0 };
+    std::vector<int> forkOrder(LANES), branchOrder(LANES * 4), joinOrder(LANES);
+
+    for(int lane = 0; lane < LANES; ++lane)
+    {
+      auto fork = graph.add([&, lane] () { forkOrder[lane] = ++order; });
+      std::vector<TaskGraph::Task> branches;
+
+      for(int k = 0; k < 4; ++k)
+        branches.push_back(graph.add([&, lane, k] () { branchOrder[lane * 4 + k] = ++order; }, { fork }));
+
+      graph.add([&, lane] () { joinOrder[lane] = ++order; }, branches);
+    }
+
+    // the graph can be run several times
+    for(int pass = 0; pass < 3; ++pass)
+    {
+      order = 0;
+      scheduler.run(graph);
+      CHECK(order == LANES * 6);
+
+      for(int lane = 0; lane < LANES; ++lane)
+      {
+        for(int k = 0; k < 4; ++k)
+        {
+          CHECK(branchOrder[lane * 4 + k] > forkOrder[lane]);
+          CHECK(branchOrder[lane * 4 + k] < joinOrder[lane]);
+        }
+      }
+    }
+  }
+}
+
+TEST(schedulerRunsAnEmptyGraph)
+{
+  Scheduler scheduler(2);
+  TaskGraph graph;
+  scheduler.run(graph);
+  CHECK(graph.nodes.empty());
+}
@@ -0,0 +1,59 @@
+#include "tests.h"
+#include <math.h>
+#include "sensors.h"
+#include "simuflow.h"
+
+TEST(sensorsFilterTheirReadings)
+{
+  Section section;
+  section.T = 100;
+  section.flux0 = 5;
+
+  SensorBank bank;
+  float raw = 0, filtered = 0, flow = 0;
+  bank.add(section, Quantity::Temperature, &raw);
+  bank.add(section, Quantity::Temperature, &filtered, 0.5);
+  bank.add(section, Quantity::Flux, &flow);
+  CHECK(bank.size() == 3);
+
+  bank.update(1, 0, bank.size());
+  CHECK(raw == 100);
+  CHECK(filtered == 50);
+  CHECK(flow == 5);
+
+  bank.update(2, 0, bank.size());
+  CHECK(filtered == 75);
+
+  // only the given range
+  section.T = 0;
+  bank.update(3, 1, 2);
+  CHECK(raw == 100);
+  CHECK_NEAR(filtered, 37.5, 1e-4);
+
+  bank.clear();
+  CHECK(bank.size() == 0);
+}
+
+TEST(sensorBankSamplesEveryPeriod)
+{
+  Section section;
+  SensorBank bank(4);
+  float reading = -1;
+  bank.add(section, Quantity::Temperature, &reading);
+
+  for(int tick = 1; tick <= 12; ++tick)
+  {
+    section.T = tick;
+    bank.update(tick, 0, bank.size());
+    CHECK(reading == (tick < 4 ? -1 : tick / 4 * 4));
+  }
+
+  // the period survives clear()
+  bank.clear();
+  bank.add(section, Quantity::Temperature, &reading);
+  section.T = 13;
+  bank.update(13, 0, 1);
+  CHECK(reading == 12);
+  bank.update(16, 0, 1);
+  CHECK(reading == 13);
+}
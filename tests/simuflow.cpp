@@ -0,0 +1,438 @@
+#include "tests.h"
+#include <math.h>
+#include "simuflow.h"
+
+namespace
+{
+// 'count' sections of 1000 units of water at 25C, each connected to the next
+void makeChain(Circuit& circuit, int count, bool ring = false)
+{
+  circuit.sections.resize(count); // no reallocation after this
+
+  for(auto& s : circuit.sections)
+    s.mass = 1000;
+
+  for(int i = 0; i + 1 < count; ++i)
+    connectSections(circuit, circuit.sections[i], circuit.sections[i + 1]);
+
+  if(ring)
+    connectSections(circuit, circuit.sections[count - 1], circuit.sections[0]);
+}
+}
+
+TEST(circuitPeriodHoldsStateBetweenUpdates)
+{
+  Circuit circuit;
+  makeChain(circuit, 1);
+  circuit.period = 5;
+  circuit.sections[0].heating = 1;
+
+  for(int tick = 1; tick <= 4; ++tick)
+    simulate(circuit, tick);
+
+  CHECK(circuit.sections[0].T == 25);
+
+  // one update integrates over the whole period
+  simulate(circuit, 5);
+  CHECK_NEAR(circuit.sections[0].T, 30, 1e-4);
+
+  for(int tick = 6; tick <= 10; ++tick)
+    simulate(circuit, tick);
+
+  CHECK_NEAR(circuit.sections[0].T, 35, 1e-4);
+}
+
+TEST(longPeriodConservesMass)
+{
+  Circuit circuit;
+  makeChain(circuit, 8, true);
+  circuit.period = 3;
+  circuit.sections[0].selfFlux = 50;
+
+  for(int tick = 1; tick <= 30; ++tick)
+    simulate(circuit, tick);
+
+  float total = 0;
+
+  for(auto& s : circuit.sections)
+    total += s.mass;
+
+  CHECK_NEAR(total, 8000, 0.01);
+  CHECK(circuit.sections[1].mass != 1000); // something moved
+}
+
+TEST(heatSourcesAndSinks)
+{
+  Circuit circuit;
+  circuit.ambientT = 10;
+  makeChain(circuit, 2);
+  circuit.connections.clear(); // two isolated sections
+  circuit.sections[0].heating = 2;
+  circuit.sections[1].cooling = 0.5;
+
+  for(int tick = 1; tick <= 10; ++tick)
+    simulate(circuit, tick);
+
+  CHECK_NEAR(circuit.sections[0].T, 45, 1e-3);
+
+  // relaxes towards ambient, never beyond
+  CHECK(circuit.sections[1].T > 10);
+  CHECK(circuit.sections[1].T < 10.1);
+}
+
+TEST(thermalLinkExchangesHeatBothWays)
+{
+  Circuit a, b;
+  makeChain(a, 1);
+  makeChain(b, 1);
+  a.sections[0].T = 100;
+  b.sections[0].T = 20;
+  connectThermal(a, a.sections[0], b.sections[0], 0.1);
+
+  simulate(a, 1);
+  CHECK_NEAR(a.sections[0].T, 92, 1e-3);
+  CHECK_NEAR(b.sections[0].T, 28, 1e-3);
+
+  // converges, without overshooting
+  for(int tick = 2; tick <= 200; ++tick)
+    simulate(a, tick);
+
+  CHECK_NEAR(a.sections[0].T, 60, 0.01);
+  CHECK_NEAR(b.sections[0].T, 60, 0.01);
+}
+
+namespace
+{
+double sumOfTemperatures(const Circuit& circuit)
+{
+  double sum = 0;
+
+  for(auto& s : circuit.sections)
+    sum += s.T;
+
+  return sum;
+}
+}
+
+TEST(explicitConductionConservesHeat)
+{
+  Circuit circuit;
+  makeChain(circuit, 16, true);
+  circuit.wallConductance = 0.1;
+  circuit.sections[3].T = 200;
+
+  for(auto& s : circuit.sections)
+    s.damping = 0; // no flow, only conduction
+
+  auto const before = sumOfTemperatures(circuit);
+
+  for(int tick = 1; tick <= 50; ++tick)
+    simulate(circuit, tick);
+
+  CHECK_NEAR(sumOfTemperatures(circuit), before, 0.01);
+  CHECK(circuit.sections[4].T > 25);
+  CHECK(circuit.sections[3].T < 200);
+}
+
+TEST(implicitConductionIsStableAtLargePeriods)
+{
+  Circuit circuit;
+  makeChain(circuit, 16, true);
+  circuit.wallConductance = 0.5;
+  circuit.implicitConduction = true;
+  circuit.period = 10; // k = 5: the explicit scheme would blow up
+  circuit.sections[3].T = 200;
+
+  for(auto& s : circuit.sections)
+    s.damping = 0;
+
+  auto const before = sumOfTemperatures(circuit);
+
+  for(int tick = 10; tick <= 200; tick += 10)
+    simulate(circuit, tick);
+
+  CHECK_NEAR(sumOfTemperatures(circuit), before, 1e-4);
+
+  // no oscillation: every section stays within the initial range
+  for(auto& s : circuit.sections)
+  {
+    CHECK(s.T >= 25 - 0.01);
+    CHECK(s.T <= 200);
+  }
+}
+
+TEST(implicitConductionConvergesAtVeryLargePeriods)
+{
+  Circuit circuit;
+  makeChain(circuit, 64, true);
+  circuit.wallConductance = 1000;
+  circuit.implicitConduction = true;
+  circuit.period = 100; // k = 1e5
+  circuit.sections[3].T = 200;
+  circuit.sections[40].T = 100;
+
+  for(auto& s : circuit.sections)
+    s.damping = 0;
+
+  auto const before = sumOfTemperatures(circuit);
+  simulate(circuit, 100);
+
+  CHECK_NEAR(sumOfTemperatures(circuit), before, 1e-4);
+
+  // a single update all but evens out the ring
+  for(auto& s : circuit.sections)
+    CHECK_NEAR(s.T, before / 64, 0.05);
+}
+
+TEST(blockedSimulationIsCloseToPlainSimulation)
+{
+  // strong flows, and a single step: the worst case for the halo
+  Circuit plain, blocked;
+
+  for(auto circuit : { &plain, &blocked })
+  {
+    makeChain(*circuit, 2000, true);
+
+    for(int i = 0; i < 2000; ++i)
+    {
+      circuit->sections[i].T = 25 + (i % 7) * 10;
+      circuit->sections[i].selfFlux = i % 10 ? 0 : 200;
+    }
+
+    for(int tick = 1; tick <= 20; ++tick)
+      simulate(*circuit, tick);
+  }
+
+  for(int steps : { 1, 4 })
+  {
+    for(int s = 0; s < steps; ++s)
+      simulate(plain, 0);
+
+    simulateBlocked(blocked, steps, 64);
+
+    double plainMass = 0;
+    double blockedMass = 0;
+
+    for(int i = 0; i < 2000; ++i)
+    {
+      CHECK_NEAR(blocked.sections[i].T, plain.sections[i].T, 0.1);
+      CHECK_NEAR(blocked.connections[i].flux, plain.connections[i].flux, 0.01);
+      plainMass += plain.sections[i].mass;
+      blockedMass += blocked.sections[i].mass;
+    }
+
+    CHECK_NEAR(blockedMass, plainMass, 0.01);
+  }
+}
+
+TEST(chainKernelMatchesGeneralKernel)
+{
+  for(bool ring : { false, true })
+  {
+    Circuit chained, general;
+
+    for(auto circuit : { &chained, &general })
+    {
+      // 10 connected sections, then 2 isolated ones
+      makeChain(*circuit, 12);
+      circuit->connections.resize(9);
+
+      if(ring)
+        connectSections(*circuit, circuit->sections[9], circuit->sections[0]);
+
+      circuit->sections[0].selfFlux = 30;
+      circuit->sections[4].heating = 3;
+      circuit->sections[7].cooling = 0.2;
+      circuit->sections[9].cooling = 0.2;
+      circuit->sections[10].T = 90;
+      circuit->sections[10].cooling = 0.2;
+      circuit->sections[11].heating = 1;
+    }
+
+    // pretend the connections aren't chained: forces the general kernel
+    general.chainedConnectionCount = (int)general.connections.size();
+    general.chained = false;
+
+    for(int tick = 1; tick <= 20; ++tick)
+    {
+      simulate(chained, tick);
+      simulate(general, tick);
+    }
+
+    CHECK(chained.chained);
+
+    for(int i = 0; i < 12; ++i)
+    {
+      CHECK(chained.sections[i].T == general.sections[i].T);
+      CHECK(chained.sections[i].mass == general.sections[i].mass);
+    }
+
+    CHECK(chained.sections[10].T < 90);
+  }
+}
+
+TEST(sameTickEventsApplyInSchedulingOrder)
+{
+  for(int count = 2; count < 40; ++count)
+  {
+    Circuit circuit;
+    makeChain(circuit, 1);
+    auto& damping = circuit.sections[0].damping;
+
+    // e.g a slider dragged faster than the tick rate
+    for(int i = 0; i < count; ++i)
+      schedule(circuit, { 5, &damping, float(i) / count });
+
+    schedule(circuit, { 6, &damping, 0.5f });
+
+    simulate(circuit, 5);
+    CHECK(damping == float(count - 1) / count);
+
+    simulate(circuit, 6);
+    CHECK(damping == 0.5f);
+  }
+}
+
+TEST(rampReachesTargetAndCanBeCancelled)
+{
+  Circuit circuit;
+  makeChain(circuit, 1);
+  auto& flux = circuit.sections[0].selfFlux;
+
+  schedule(circuit, { 10, &flux, 100, 10 });
+
+  int tick = 0;
+
+  auto runUntil = [&] (int last)
+    {
+      while(tick < last)
+        simulate(circuit, ++tick);
+    };
+
+  runUntil(9);
+  CHECK(flux == 0);
+
+  runUntil(15);
+  CHECK_NEAR(flux, 50, 1e-3);
+
+  runUntil(20);
+  CHECK(flux == 100);
+
+  // a new event cancels the ramp in progress
+  schedule(circuit, { 21, &flux, 0, 100 });
+  schedule(circuit, { 22, &flux, 7 });
+  runUntil(50);
+  CHECK(flux == 7);
+}
+
+namespace
+{
+double totalMass(const Circuit& circuit)
+{
+  double r = 0;
+
+  for(auto& s : circuit.sections)
+    r += s.mass;
+
+  return r;
+}
+}
+
+TEST(packedStorageRoundTrip)
+{
+  Circuit circuit;
+  makeChain(circuit, 100, true);
+
+  for(int i = 0; i < 100; ++i)
+  {
+    circuit.sections[i].mass = 500 + i * 10;
+    circuit.sections[i].T = 20 + i;
+    circuit.sections[i].damping = i % 2 ? 0.5 : 0.99;
+  }
+
+  auto packed = pack(circuit);
+  CHECK(packed.types.size() == 2);
+
+  auto const before = totalMass(circuit);
+  unpack(packed, circuit);
+
+  for(int i = 0; i < 100; ++i)
+  {
+    CHECK_NEAR(circuit.sections[i].mass, 500 + i * 10, packed.massScale);
+    CHECK_NEAR(circuit.sections[i].T, 20 + i, packed.temperatureScale);
+    CHECK(circuit.sections[i].damping == (i % 2 ? 0.5f : 0.99f));
+  }
+
+  CHECK_NEAR(totalMass(circuit), before, 0.01);
+}
+
+TEST(packedSimulationConservesMass)
+{
+  Circuit circuit;
+  makeChain(circuit, 1000, true);
+
+  for(int i = 0; i < 1000; i += 10)
+    circuit.sections[i].selfFlux = 100;
+
+  for(int tick = 1; tick <= 20; ++tick)
+    simulate(circuit, tick);
+
+  auto const before = totalMass(circuit);
+  auto packed = pack(circuit);
+
+  for(int pass = 0; pass < 20; ++pass)
+    simulateBlocked(packed, 4, 64);
+
+  unpack(packed, circuit);
+
+  // without carrying the rounding errors, the drift is several scale units
+  CHECK_NEAR(totalMass(circuit), before, packed.massScale * 0.5);
+}
+
+TEST(sortConnectionsKeepsTheSolverConsistent)
+{
+  Circuit sorted, fresh;
+
+  for(auto circuit : { &sorted, &fresh })
+  {
+    // the connections of a chain, in reverse order
+    circuit->sections.resize(200);
+
+    for(int i = 198; i >= 0; --i)
+      connectSections(*circuit, circuit->sections[i], circuit->sections[i + 1]);
+
+    for(auto& s : circuit->sections)
+      s.mass = 1000;
+
+    circuit->sections[0].selfFlux = 50;
+    simulateBlocked(*circuit, 4, 64);
+    sortConnections(*circuit);
+  }
+
+  CHECK(sorted.connections[0].sections[0] == &sorted.sections[0]);
+  CHECK(sorted.connections[198].sections[0] == &sorted.sections[198]);
+
+  // same connections, with a solver workspace rebuilt from scratch
+  fresh.adjacency = {};
+  fresh.chainedConnectionCount = -1;
+
+  for(int pass = 0; pass < 4; ++pass)
+  {
+    simulateBlocked(sorted, 4, 64);
+    simulateBlocked(fresh, 4, 64);
+  }
+
+  for(int tick = 1; tick <= 10; ++tick)
+  {
+    simulate(sorted, tick);
+    simulate(fresh, tick);
+  }
+
+  CHECK(sorted.chained);
+
+  for(int i = 0; i < 199; ++i)
+    CHECK(sorted.connections[i].flux == fresh.connections[i].flux);
+
+  for(int i = 0; i < 200; ++i)
+    CHECK(sorted.sections[i].mass == fresh.sections[i].mass);
+}
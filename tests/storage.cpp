@@ -0,0 +1,76 @@
+#include "tests.h"
+#include <math.h>
+#include "simuflow.h"
+#include "storage.h"
+
+namespace
+{
+const Backing backings[] =
+{
+  Backing::Heap,
+  Backing::File,
+  Backing::TransparentHugePages,
+  Backing::HugePages,
+};
+}
+
+TEST(arraysKeepTheirBacking)
+{
+  for(auto backing : backings)
+  {
+    setStorageBacking(backing);
+    Array<int> a(100000);
+    setStorageBacking(Backing::Heap);
+
+    CHECK(a.get_allocator().backing == backing);
+
+    for(int i = 0; i < (int)a.size(); ++i)
+      a[i] = i;
+
+    // growing reallocates with the same backing
+    a.resize(300000, 7);
+    CHECK(a.get_allocator().backing == backing);
+    CHECK(a[99999] == 99999);
+    CHECK(a[299999] == 7);
+
+    Array<int> copy = a;
+    CHECK(copy.get_allocator().backing == backing);
+    CHECK(copy[12345] == 12345);
+  }
+}
+
+TEST(circuitOnMappedFileSimulatesLikeOnHeap)
+{
+  Circuit heap;
+
+  setStorageBacking(Backing::File);
+  Circuit mapped;
+  setStorageBacking(Backing::Heap);
+
+  for(auto circuit : { &heap, &mapped })
+  {
+    circuit->sections.resize(500);
+
+    for(auto& s : circuit->sections)
+      s.mass = 1000;
+
+    for(int i = 0; i < 500; ++i)
+      connectSections(*circuit, circuit->sections[i], circuit->sections[(i + 1) % 500]);
+
+    circuit->sections[0].selfFlux = 50;
+    circuit->sections[100].heating = 2;
+
+    for(int tick = 1; tick <= 20; ++tick)
+      simulate(*circuit, tick);
+
+    simulateBlocked(*circuit, 4, 64);
+  }
+
+  CHECK(mapped.adjacency.neighbours.get_allocator().backing == Backing::File);
+
+  for(int i = 0; i < 500; ++i)
+  {
+    CHECK(mapped.sections[i].T == heap.sections[i].T);
+    CHECK(mapped.sections[i].mass == heap.sections[i].mass);
+  }
+}
@@ -0,0 +1,69 @@
+#include "tests.h"
+#include <string.h>
+#include <string>
+#include "stringtable.h"
+
+TEST(stringTableInternsEachStringOnce)
+{
+  StringTable table;
+  CHECK(table.find("pump") == -1);
+
+  auto const pump = table.intern("pump");
+  auto const valve = table.intern("valve");
+  CHECK(pump != valve);
+  CHECK(table.intern("pump") == pump);
+  CHECK(table.find("valve") == valve);
+  CHECK(table.size() == 2);
+
+  // the table keeps its own copy
+  char name[] = "pipe";
+  auto const pipe = table.intern(name);
+  name[0] = 'w';
+  CHECK(strcmp(table.get(pipe), "pipe") == 0);
+  CHECK(table.find("wipe") == -1);
+
+  table.clear();
+  CHECK(table.size() == 0);
+  CHECK(table.find("pump") == -1);
+}
+
+TEST(stringTableGrowsWithoutMovingStrings)
+{
+  StringTable table;
+  auto const first = table.get(table.intern("first"));
+
+  for(int i = 0; i < 100000; ++i)
+    table.intern(("id " + std::to_string(i)).c_str());
+
+  CHECK(table.size() == 100001);
+  CHECK(table.get(table.find("first")) == first);
+  CHECK(table.find("id 99999") == 100000);
+  CHECK(strcmp(table.get(table.find("id 12345")), "id 12345") == 0);
+}
+
+TEST(stringTableFindsPrefixesInOrder)
+{
+  StringTable table;
+
+  for(auto name : { "b2", "a", "b10", "c", "b1", "ab" })
+    table.intern(name);
+
+  auto ids = table.withPrefix("b");
+  CHECK(ids.size() == 3);
+
+  if(ids.size() == 3)
+  {
+    CHECK(strcmp(table.get(ids[0]), "b1") == 0);
+    CHECK(strcmp(table.get(ids[1]), "b10") == 0);
+    CHECK(strcmp(table.get(ids[2]), "b2") == 0);
+  }
+
+  CHECK(table.withPrefix("").size() == 6);
+  CHECK(table.withPrefix("d").size() == 0);
+
+  // strings interned later are found too
+  table.intern("b0");
+  ids = table.withPrefix("b");
+  CHECK(ids.size() == 4);
+  CHECK(ids.size() && strcmp(table.get(ids[0]), "b0") == 0);
+}
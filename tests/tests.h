@@ -0,0 +1,19 @@
+// Minimal unit test harness: each TEST() registers itself, main() runs them all.
+#pragma once
+
+void registerTest(const char* name, void (* func)());
+void reportFailure(const char* file, int line, const char* expr);
+
+#define CHECK(expr) \
+  do { \
+    if(!(expr)) \
+      reportFailure(__FILE__, __LINE__, #expr); \
+  } while(0)
+
+#define CHECK_NEAR(a, b, tolerance) \
+  CHECK(fabs(double(a) - double(b)) <= double(tolerance))
+
+#define TEST(name) \
+  static void name(); \
+  static const int name ## _registration = (registerTest(#name, &name), 0); \
+  static void name()